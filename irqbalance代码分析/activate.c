@@ -3,34 +3,43 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <fcntl.h>
 
 #include "irqbalance.h"
 
-/*irq_infoж׺ͶϢжapplied_maskǷһ*/
-static int check_affinity(struct irq_info *info, cpumask_t applied_mask)
+/* hex digits, one comma per 32 cpus and the trailing newline */
+#define AFFINITY_BUF_LEN (NR_CPUS / 4 + NR_CPUS / 32 + 2)
+
+struct migration_stats migration_stats;
+
+/* cpus an irq can stay on: placed in the tree and not in powersave */
+static cpumask_t live_cpus;
+
+/*irq_infoж׺ͶϢжapplied_maskǷһ£ȡصǰ׺Ͷ*/
+static int check_affinity(struct irq_info *info, const cpumask_t *applied_mask,
+			  cpumask_t *current)
 {
 	cpumask_t current_mask;
 	char buf[PATH_MAX];
-	char *line = NULL;
-	size_t size = 0;
-	FILE *file;
+	char line[AFFINITY_BUF_LEN];
+	ssize_t len;
+	int fd;
     /*bufжϵ׺ͶĿ¼·*/
 	sprintf(buf, "/proc/irq/%i/smp_affinity", info->irq);
-	file = fopen(buf, "r");
-	if (!file)
+	fd = open(buf, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 		return 1;
-	/*getlineڶȡһֱַзļβɹʱضȡֽlineȡַ*/
-	if (getline(&line, &size, file)==0) {
-		free(line);
-		fclose(file);
+	/*һζ뵽ջϵĻstdioҲڴ*/
+	len = read(fd, line, sizeof(line) - 1);
+	close(fd);
+	if (len <= 0)
 		return 1;
-	}
+	line[len] = '\0';
 	/*õ׺ͶϢתλͼϢ*/
-	cpumask_parse_user(line, strlen(line), current_mask);
-	fclose(file);
-	free(line);
+	cpumask_parse_user(line, len, current_mask);
+	*current = current_mask;
 	/*жapplied_maskǷжϵ׺Ͷһ*/
-	return cpus_equal(applied_mask, current_mask);
+	return cpus_equal(*applied_mask, current_mask);
 }
 
 /*ԽǨƵж׺Ͷӳ*/
@@ -38,7 +47,7 @@ static void activate_mapping(struct irq_info *info, void *data __attribute__((un
 {
 	char buf[PATH_MAX];
 	FILE *file;
-	cpumask_t applied_mask;
+	cpumask_t applied_mask, current_mask;
 	int valid_mask = 0;
 
 	/*ֻнǨƲûмӳжҪӳ伤*/
@@ -83,12 +92,18 @@ static void activate_mapping(struct irq_info *info, void *data __attribute__((un
 	}
 
 	/*׺Ͷòɹõ׺Ͷλͼirq_infoԭһ£ֱӷ*/
-	if (!valid_mask || check_affinity(info, applied_mask))
+	if (!valid_mask || check_affinity(info, &applied_mask, &current_mask))
 		return;
 
 	if (!info->assigned_obj)
 		return;
 
+	/*ȴڵǰCPUȻʱݲджϱmoved״̬ȴڹд*/
+	if (irq_cooling_down(info) && cpus_intersects(current_mask, live_cpus)) {
+		migration_stats.cooling++;
+		return;
+	}
+
 	sprintf(buf, "/proc/irq/%i/smp_affinity", info->irq);
 	file = fopen(buf, "w");
 	if (!file)
@@ -101,10 +116,35 @@ static void activate_mapping(struct irq_info *info, void *data __attribute__((un
 
 	/*ǨƵжѾ׺Ͷӳ*/
 	info->moved = 0;
+	info->moved_ns = monotonic_ns();
+	info->nr_moves++;
+	migration_stats.performed++;
+}
+
+/*ڽģʽCPUԼж*/
+static void add_live_cpu(struct topo_obj *d, void *data __attribute__((unused)))
+{
+	if (!d->powersave_mode)
+		cpus_or(live_cpus, live_cpus, d->mask);
 }
 
 /*ϵͳжϣԽǨƲδ׺ͶϢж׺ͶϢ*/
 void activate_mappings(void)
 {
+	struct migration_stats *st = &migration_stats;
+
+	cpus_clear(live_cpus);
+	for_each_object(cpus, add_live_cpu, NULL);
 	for_each_irq(NULL, activate_mapping, NULL);
+
+	/*汾ʵǨƺͱֹжĿ*/
+	st->total_performed += st->performed;
+	st->total_prevented += st->cooling + st->unprofitable;
+	if (st->performed || st->cooling || st->unprofitable)
+		log(TO_CONSOLE, LOG_INFO,
+		    "irq moves: %u performed, %u held by cooldown, %u not worth the cost "
+		    "(%llu performed, %llu prevented in total)\n",
+		    st->performed, st->cooling, st->unprofitable,
+		    st->total_performed, st->total_prevented);
+	st->performed = st->cooling = st->unprofitable = 0;
 }
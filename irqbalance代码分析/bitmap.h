@@ -19,24 +19,15 @@
 
 #include "non-atomic.h"
 
+/* gcc emits popcnt where the target has it, and a bit count otherwise */
 static inline unsigned int hweight32(unsigned int w)
 {
-        unsigned int res = w - ((w >> 1) & 0x55555555);
-        res = (res & 0x33333333) + ((res >> 2) & 0x33333333);
-        res = (res + (res >> 4)) & 0x0F0F0F0F;
-        res = res + (res >> 8);
-        return (res + (res >> 16)) & 0x000000FF;
+	return __builtin_popcount(w);
 }
 
 static inline unsigned long hweight64(uint64_t w)
 {
-	if (BITS_PER_LONG == 32) 
-	        return hweight32((unsigned int)(w >> 32)) + hweight32((unsigned int)w);
-
-        w -= (w >> 1) & 0x5555555555555555ull;
-        w =  (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
-        w =  (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
-        return (w * 0x0101010101010101ull) >> 56;
+	return __builtin_popcountll(w);
 }
 
 
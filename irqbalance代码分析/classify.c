@@ -60,34 +60,89 @@ struct user_irq_policy {
 	enum hp_e hintpolicy;
 };
 
-static GList *interrupts_db = NULL;
-static GList *banned_irqs = NULL;
-static GList *cl_banned_irqs = NULL;
+static struct irq_list interrupts_db = { .db = 1 };
+static struct irq_list banned_irqs = { .db = 1 };
+static struct irq_list cl_banned_irqs = { .db = 1 };
+
+/*
+ * Memory the irq_infos are allocated from.  The irq db is reset in one go
+ * on a rescan, the command line bans outlive rescans and get their own pool
+ */
+static struct obj_pool irq_pool = OBJ_POOL_INIT(struct irq_info);
+static struct obj_pool cl_banned_pool = OBJ_POOL_INIT(struct irq_info);
+
+/*
+ * Direct-indexed lookup table for every irq in interrupts_db and banned_irqs.
+ * Irqs numbered at or above IRQ_TABLE_MAX are only reachable via the lists
+ */
+static struct irq_info **irq_table = NULL;
+static int irq_table_size = 0;
+
+#define IRQ_TABLE_MIN 256
+#define IRQ_TABLE_MAX (1 << 20)
 
 #define SYSDEV_DIR "/sys/bus/pci/devices"
 
-/*ڱȽжǷһ*/
-static gint compare_ints(gconstpointer a, gconstpointer b)
+/*ажϺŲж*/
+static struct irq_info *find_irq_in_list(struct irq_list *list, int irq)
 {
-	const struct irq_info *ai = a;
-	const struct irq_info *bi = b;
+	struct irq_link *link;
+
+	for (link = list->first; link; link = link->next)
+		if (link->info->irq == irq)
+			return link->info;
+	return NULL;
+}
+
+/*жϼ¼ұУռ䲻ʱ2ݴ*/
+static void irq_table_insert(struct irq_info *info)
+{
+	struct irq_info **new_table;
+	int new_size;
+
+	if (info->irq < 0 || info->irq >= IRQ_TABLE_MAX)
+		return;
+
+	if (info->irq >= irq_table_size) {
+		new_size = irq_table_size ? irq_table_size : IRQ_TABLE_MIN;
+		while (new_size <= info->irq)
+			new_size <<= 1;
+		new_table = realloc(irq_table, new_size * sizeof(struct irq_info *));
+		if (!new_table) {
+			log(TO_CONSOLE, LOG_WARNING, "No memory to index irq %d\n", info->irq);
+			return;
+		}
+		memset(&new_table[irq_table_size], 0,
+		       (new_size - irq_table_size) * sizeof(struct irq_info *));
+		irq_table = new_table;
+		irq_table_size = new_size;
+	}
 
-	return ai->irq - bi->irq;
+	irq_table[info->irq] = info;
+}
+
+/*ղұռһνݿʹ*/
+static void irq_table_clear(void)
+{
+	if (irq_table)
+		memset(irq_table, 0, irq_table_size * sizeof(struct irq_info *));
 }
 
 /*һbannedж*/
-static void add_banned_irq(int irq, GList **list)
+static void add_banned_irq(int irq, struct irq_list *list)
 {
-	struct irq_info find, *new;
-	GList *entry;
+	struct irq_info *new;
 
-	find.irq = irq;
-	/*жָжѴڣӣֱӷ*/
-	entry = g_list_find_custom(*list, &find, compare_ints);
-	if (entry)
+	/*ָжѴڣӣֱӷءbanned_irqsеж϶¼ڲұУ
+	нֹж*/
+	if (list == &banned_irqs) {
+		if (get_irq_info(irq))
+			return;
+	} else if (find_irq_in_list(list, irq)) {
 		return;
+	}
 	/*µжϣռ䡢жϢж*/
-	new = calloc(sizeof(struct irq_info), 1);
+	new = obj_pool_alloc(list == &cl_banned_irqs ? &cl_banned_pool : &irq_pool);
 	if (!new) {
 		log(TO_CONSOLE, LOG_WARNING, "No memory to ban irq %d\n", irq);
 		return;
@@ -97,7 +152,9 @@ static void add_banned_irq(int irq, GList **list)
 	new->flags |= IRQ_FLAG_BANNED;
 	new->hint_policy = HINT_POLICY_EXACT;
 
-	*list = g_list_append(*list, new);
+	irq_list_append(list, new);
+	if (list == &banned_irqs)
+		irq_table_insert(new);
 	return;
 }
 
@@ -107,18 +164,6 @@ void add_cl_banned_irq(int irq)
 	add_banned_irq(irq, &cl_banned_irqs);
 }
 
-/*жirqǷbanned_irqs*/
-static int is_banned_irq(int irq)
-{
-	GList *entry;
-	struct irq_info find;
-
-	find.irq = irq;
-
-	entry = g_list_find_custom(banned_irqs, &find, compare_ints);
-	return entry ? 1:0;
-}
-
 			
 /*irq뵽жݿУжϵϢͣ׺ͶȲԣһڴʽڵϢdevpathΪ
 ļϵͳָ豸·*/
@@ -126,40 +171,37 @@ static struct irq_info *add_one_irq_to_db(const char *devpath, int irq, struct u
 {
 	int class = 0;
 	int rc;
-	struct irq_info *new, find;
+	struct irq_info *new, *old;
 	int numa_node;
 	char path[PATH_MAX];
 	FILE *fd;
 	char *lcpu_mask;
-	GList *entry;
 	ssize_t ret;
 	size_t blen;
 
-	/*жǷѴڣѴ򷵻ؿ */
-	find.irq = irq;
-	entry = g_list_find_custom(interrupts_db, &find, compare_ints);
-	if (entry) {
-		log(TO_CONSOLE, LOG_INFO, "DROPPING DUPLICATE ENTRY FOR IRQ %d on path %s\n", irq, devpath);
-		return NULL;
-	}
-
-	/*жǷbannedжϣ򷵻ؿ*/
-	if (is_banned_irq(irq)) {
-		log(TO_ALL, LOG_INFO, "SKIPPING BANNED IRQ %d\n", irq);
+	/*жǷѴڻbannedжϣ򷵻ؿ */
+	old = get_irq_info(irq);
+	if (old) {
+		if (old->flags & IRQ_FLAG_BANNED)
+			log(TO_ALL, LOG_INFO, "SKIPPING BANNED IRQ %d\n", irq);
+		else
+			log(TO_CONSOLE, LOG_INFO, "DROPPING DUPLICATE ENTRY FOR IRQ %d on path %s\n", irq, devpath);
 		return NULL;
 	}
 
 	/*жϢռ䲢*/
-	new = calloc(sizeof(struct irq_info), 1);
+	new = obj_pool_alloc(&irq_pool);
 	if (!new)
 		return NULL;
 
 	new->irq = irq;
 	new->class = IRQ_OTHER;
 	new->hint_policy = pol->hintpolicy; 
+	new->home_package = -1;
 
-	/*жϼж*/
-	interrupts_db = g_list_append(interrupts_db, new);
+	/*жϼжұ*/
+	irq_list_append(&interrupts_db, new);
+	irq_table_insert(new);
 
 	sprintf(path, "%s/class", devpath);
 
@@ -204,24 +246,7 @@ get_numa_node:
 	else
 		new->numa_node = get_numa_node(numa_node);
 
-	sprintf(path, "%s/local_cpus", devpath);
-	fd = fopen(path, "r");
-	if (!fd) {
-		cpus_setall(new->cpumask);
-		goto assign_affinity_hint;
-	}
-	lcpu_mask = NULL;
-	ret = getline(&lcpu_mask, &blen, fd);
-	fclose(fd);
-	if (ret <= 0) {
-		cpus_setall(new->cpumask);
-	} else {
-		cpumask_parse_user(lcpu_mask, ret, new->cpumask);
-	}
-	free(lcpu_mask);
-
 /*irqaffinity_hint*/
-assign_affinity_hint:
 	cpus_clear(new->affinity_hint);
 	sprintf(path, "/proc/irq/%d/affinity_hint", irq);
 	fd = fopen(path, "r");
@@ -365,13 +390,9 @@ static int check_for_irq_ban(char *path, int irq)
 {
 	char *cmd;
 	int rc;
-	struct irq_info find;
-	GList *entry;
 
 	/* жǷcl_banned_irqs */
-	find.irq = irq;
-	entry = g_list_find_custom(cl_banned_irqs, &find, compare_ints);
-	if (entry)
+	if (find_irq_in_list(&cl_banned_irqs, irq))
 		return 1;
 
 	/*ûbanĲԽű*/
@@ -407,13 +428,35 @@ static int check_for_irq_ban(char *path, int irq)
 }
 
 /*Ϊ·µ豸жڣmsi-xԼintж */
+/*жϼanchor豸msi*/
+static void link_device_vector(struct irq_info *anchor, struct irq_info *info)
+{
+	if (!anchor || anchor == info)
+		return;
+	info->dev_next = anchor->dev_next ? anchor->dev_next : anchor;
+	anchor->dev_next = info;
+}
+
+/*жϴ豸msiժ*/
+static void unlink_device_vector(struct irq_info *info)
+{
+	struct irq_info *prev = info->dev_next;
+
+	if (!prev)
+		return;
+	while (prev->dev_next != info)
+		prev = prev->dev_next;
+	prev->dev_next = (info->dev_next == prev) ? NULL : info->dev_next;
+	info->dev_next = NULL;
+}
+
 static void build_one_dev_entry(const char *dirname)
 {
 	struct dirent *entry;
 	DIR *msidir;
 	FILE *fd;
 	int irqnum;
-	struct irq_info *new;
+	struct irq_info *new, *vector = NULL;
 	char path[PATH_MAX];
 	char devpath[PATH_MAX];
 	struct user_irq_policy pol;
@@ -433,8 +476,11 @@ static void build_one_dev_entry(const char *dirname)
 			irqnum = strtol(entry->d_name, NULL, 10);
 			if (irqnum) {
 				new = get_irq_info(irqnum);
-				if (new)
+				if (new) {
+					if (!(new->flags & IRQ_FLAG_BANNED) && !vector)
+						vector = new;
 					continue;
+				}
 				get_irq_user_policy(devpath, irqnum, &pol);
 				if ((pol.ban == 1) || (check_for_irq_ban(devpath, irqnum))) {
 					add_banned_irq(irqnum, &banned_irqs);
@@ -443,8 +489,11 @@ static void build_one_dev_entry(const char *dirname)
 				new = add_one_irq_to_db(devpath, irqnum, &pol);
 				if (!new)
 					continue;
-				/*ж*/
+				/*жͣͬһ豸ɻʱɢͬcache*/
 				new->type = IRQ_TYPE_MSIX;
+				link_device_vector(vector, new);
+				if (!vector)
+					vector = new;
 			}
 		} while (entry != NULL);
 		closedir(msidir);
@@ -480,23 +529,29 @@ done:
 	return;
 }
 
+/*ͷжϵÿCPU*/
+static void free_irq_counts(struct irq_info *info, void *data __attribute__((unused)))
+{
+	free(info->cpu_counts);
+}
+
 /*ͷһж(жϢṹ) */
 static void free_irq(struct irq_info *info, void *data __attribute__((unused)))
 {
-	free(info);
+	free(info->cpu_counts);
+	obj_pool_free(&irq_pool, info);
 }
 
-/*ͷжϺж*/
+/*ͷжϺжжϢṹ黹ڴ*/
 void free_irq_db(void)
 {
-	for_each_irq(NULL, free_irq, NULL);
-	g_list_free(interrupts_db);
-	interrupts_db = NULL;
-	for_each_irq(banned_irqs, free_irq, NULL);
-	g_list_free(banned_irqs);
-	banned_irqs = NULL;
-	g_list_free(rebalance_irq_list);
-	rebalance_irq_list = NULL;
+	for_each_irq(NULL, free_irq_counts, NULL);
+	irq_list_init(&interrupts_db, 1);
+	for_each_irq(&banned_irqs, free_irq_counts, NULL);
+	irq_list_init(&banned_irqs, 1);
+	irq_list_init(&rebalance_irq_list, 0);
+	obj_pool_reset(&irq_pool);
+	irq_table_clear();
 }
 
 /*ΪһµжжϢж*/
@@ -542,21 +597,15 @@ static void add_missing_irq(struct irq_info *info, void *unused __attribute__((u
 	
 }
 
-/*Ϊϵͳ豸жڣжϼж*/
-void rebuild_irq_db(void)
+/*ϵͳPCI豸ΪݿежϽ*/
+static void scan_pci_devices(void)
 {
 	DIR *devdir;
 	struct dirent *entry;
-	GList *tmp_irqs = NULL;
-
-	free_irq_db();
-
-	/*ȡϵͳж*/
-	tmp_irqs = collect_full_irq_list();
 
 	devdir = opendir(SYSDEV_DIR);
 	if (!devdir)
-		goto free;
+		return;
 
 	do {
 		entry = readdir(devdir);
@@ -569,78 +618,278 @@ void rebuild_irq_db(void)
 	} while (entry != NULL);
 
 	closedir(devdir);
+}
+
+/*Ϊϵͳ豸жڣжϼж*/
+void rebuild_irq_db(void)
+{
+	struct irq_list tmp_irqs;
+	struct obj_pool tmp_pool = OBJ_POOL_INIT(struct irq_info);
 
+	free_irq_db();
 
-	for_each_irq(tmp_irqs, add_missing_irq, NULL);
+	/*ȡϵͳжЩжֻڽݿڼʹãڴֱͷ*/
+	irq_list_init(&tmp_irqs, 1);
+	collect_full_irq_list(&tmp_irqs, &tmp_pool);
 
-free:
-	g_list_free_full(tmp_irqs, free);
+	scan_pci_devices();
 
+	for_each_irq(&tmp_irqs, add_missing_irq, NULL);
+
+	for_each_irq(&tmp_irqs, free_irq_counts, NULL);
+	obj_pool_release(&tmp_pool);
 }
 
-/*жĬǱжݿ*/
-void for_each_irq(GList *list, void (*cb)(struct irq_info *info, void *data), void *data)
+/*¼ݿжϷǨУȴһη*/
+static void queue_new_irq(struct irq_info *info)
+{
+	if (info->level == BALANCE_NONE)
+		return;
+
+	irq_list_append(&rebalance_irq_list, info);
+}
+
+/*
+ * Add an irq that showed up in /proc/interrupts after the database was
+ * built, without rebuilding it.  The pci devices are rescanned at most
+ * once per /proc/interrupts pass (tracked through *devices_scanned), so
+ * every vector of a newly added device is picked up together; irqs no
+ * device claims are classified from hint like add_missing_irq() does.
+ * Every irq added here is queued for placement.
+ */
+struct irq_info *add_new_irq_incremental(struct irq_info *hint, int *devices_scanned)
 {
-	GList *entry = g_list_first(list ? list : interrupts_db);
-	GList *next;
+	struct irq_info *info;
+	struct irq_link *last, *link;
 
-	while (entry) {
-		next = g_list_next(entry);
-		cb(entry->data, data);
-		entry = next;
+	last = interrupts_db.last;
+
+	if (!*devices_scanned) {
+		scan_pci_devices();
+		*devices_scanned = 1;
 	}
+
+	if (!get_irq_info(hint->irq))
+		add_new_irq(hint->irq, hint);
+
+	for (link = last ? last->next : interrupts_db.first; link; link = link->next)
+		queue_new_irq(link->info);
+
+	info = get_irq_info(hint->irq);
+	if (info)
+		log(TO_CONSOLE, LOG_INFO, "Added new irq %d without a rescan\n", info->irq);
+	return info;
 }
 
-/*ȡжϢ*/
-struct irq_info *get_irq_info(int irq)
+/*
+ * Add the irqs of one newly added (or newly bound) pci device, queueing
+ * them for placement.  Returns how many irqs were added.
+ */
+int add_pci_device_irqs(const char *dirname)
 {
-	GList *entry;
-	struct irq_info find;
+	struct irq_link *last, *link;
+	int added = 0;
 
-	find.irq = irq;
-	entry = g_list_find_custom(interrupts_db, &find, compare_ints);
+	last = interrupts_db.last;
 
-	if (!entry)
-		entry = g_list_find_custom(banned_irqs, &find, compare_ints);
+	build_one_dev_entry(dirname);
 
-	return entry ? entry->data : NULL;
+	for (link = last ? last->next : interrupts_db.first; link; link = link->next) {
+		queue_new_irq(link->info);
+		added++;
+	}
+	return added;
 }
 
+/*жϴݿɾͬʱڵǨƳ*/
+void remove_irq_from_db(struct irq_info *info)
+{
+	set_irq_obj(info, NULL);
+	unlink_device_vector(info);
+	if (info->link.list)
+		irq_list_del(info->link.list, info);
+	if (info->db_link.list)
+		irq_list_del(info->db_link.list, info);
+
+	if (info->irq >= 0 && info->irq < irq_table_size)
+		irq_table[info->irq] = NULL;
+
+	log(TO_CONSOLE, LOG_INFO, "Removing IRQ %d from database\n", info->irq);
+	free_irq(info, NULL);
+}
 
-/*жϴһǨƵһУΪǨ*/
-void migrate_irq(GList **from, GList **to, struct irq_info *info)
+/*жڱν/proc/interruptsʱûг֣˵ѱͷţɾ*/
+static void retire_irq_if_stale(struct irq_info *info, void *data)
 {
-	GList *entry;
-	struct irq_info find, *tmp;
+	uint64_t *generation = data;
 
-	find.irq = info->irq;
-	entry = g_list_find_custom(*from, &find, compare_ints);
+	if (info->seen_generation != *generation)
+		remove_irq_from_db(info);
+}
 
-	if (!entry)
-		return;
+/*
+ * Drop every irq that was missing from the /proc/interrupts pass
+ * numbered generation
+ */
+void retire_stale_irqs(uint64_t generation)
+{
+	for_each_irq(NULL, retire_irq_if_stale, &generation);
+	if (banned_irqs.count)
+		for_each_irq(&banned_irqs, retire_irq_if_stale, &generation);
+}
+
+/*жĬǱжݿ*/
+void for_each_irq(struct irq_list *list, void (*cb)(struct irq_info *info, void *data), void *data)
+{
+	struct irq_link *link = (list ? list : &interrupts_db)->first;
+	struct irq_link *next;
+
+	/*ص԰ѵǰжƳ*/
+	while (link) {
+		next = link->next;
+		cb(link->info, data);
+		link = next;
+	}
+}
+
+/*ֹǨƵж*/
+void for_each_banned_irq(void (*cb)(struct irq_info *info, void *data), void *data)
+{
+	for_each_irq(&banned_irqs, cb, data);
+}
 
-	tmp = entry->data;
-	*from = g_list_delete_link(*from, entry);
+/*ȡжϢұǷΧڵжֱõ*/
+struct irq_info *get_irq_info(int irq)
+{
+	struct irq_info *info;
 
+	if (irq >= 0 && irq < IRQ_TABLE_MAX)
+		return (irq < irq_table_size) ? irq_table[irq] : NULL;
+
+	info = find_irq_in_list(&interrupts_db, irq);
+	if (!info)
+		info = find_irq_in_list(&banned_irqs, irq);
+	return info;
+}
 
-	*to = g_list_append(*to, tmp);
+
+/*жϴһǨƵһУΪǨ*/
+void migrate_irq(struct irq_list *from, struct irq_list *to, struct irq_info *info)
+{
+	/*жԼ¼ڵfromʱǨ*/
+	if (irq_list_link(from, info)->list != from)
+		return;
+
+	irq_list_append(to, info);
 	info->moved = 1;
 }
 
-/*жǷȷ*/
-static gint sort_irqs(gconstpointer A, gconstpointer B)
+/*
+ * Set the object the irq is placed in, keeping the per class irq counts
+ * of the object and its ancestors, and the irq's home package, up to date
+ */
+void set_irq_obj(struct irq_info *info, struct topo_obj *obj)
 {
-        struct irq_info *a, *b;
-        a = (struct irq_info*)A;
-        b = (struct irq_info*)B;
+	struct topo_obj *d;
+
+	for (d = info->assigned_obj; d; d = d->parent)
+		d->class_count[info->class]--;
+	info->assigned_obj = obj;
+	for (d = obj; d; d = d->parent) {
+		d->class_count[info->class]++;
+		if (d->obj_type == OBJ_TYPE_PACKAGE)
+			info->home_package = d->number;
+	}
+}
 
-	if (a->class < b->class || a->load < b->load || a < b)
-		return 1;
-        return -1;
+/*
+ * The irqs of a list are ordered by class, then load, both descending,
+ * then by irq number, so that the same snapshot always gives the same
+ * order.  That is a stable LSD radix sort over a flat array, one byte of
+ * the key per pass: first the irq number, then the load, then the class.
+ * Passes where every irq has the same byte are skipped, which leaves
+ * only a few for the load values of one cycle.
+ */
+#define IRQ_SORT_PASSES 13
+
+struct irq_sort_ent {
+	uint64_t load;
+	int irq;
+	int class;
+	struct irq_info *info;
+};
+
+static struct irq_sort_ent *irq_sort_ents = NULL;
+static struct irq_sort_ent *irq_sort_tmp = NULL;
+static int irq_sort_ents_size = 0;
+static int irq_sort_tmp_size = 0;
+
+/*ȡؼֵĵpassֽڣĹؼȡ*/
+static inline unsigned int irq_sort_byte(const struct irq_sort_ent *e, int pass)
+{
+	if (pass < 4)
+		return ((unsigned int)e->irq >> (8 * pass)) & 0xff;
+	if (pass < 12)
+		return (~e->load >> (8 * (pass - 4))) & 0xff;
+	return ~e->class & 0xff;
 }
 
-/*жǷȷʽûУ¶*/
-void sort_irq_list(GList **list)
+/*ж*/
+void sort_irq_list(struct irq_list *list)
 {
-	*list = g_list_sort(*list, sort_irqs);
+	static unsigned int counts[IRQ_SORT_PASSES][256];
+	struct irq_sort_ent *src, *dst, *swap;
+	struct irq_link *link, *prev = NULL;
+	unsigned int n = list->count, i, b, off, c;
+	int pass;
+
+	if (n < 2)
+		return;
+	if (grow_array((void **)&irq_sort_ents, &irq_sort_ents_size, n, sizeof(struct irq_sort_ent)) ||
+	    grow_array((void **)&irq_sort_tmp, &irq_sort_tmp_size, n, sizeof(struct irq_sort_ent))) {
+		log(TO_CONSOLE, LOG_WARNING, "No memory to sort %u irqs\n", n);
+		return;
+	}
+
+	/*Уͬʱͳÿһ˸ֵֵֽĴ*/
+	memset(counts, 0, sizeof(counts));
+	for (i = 0, link = list->first; link; link = link->next, i++) {
+		irq_sort_ents[i].load = link->info->load;
+		irq_sort_ents[i].irq = link->info->irq;
+		irq_sort_ents[i].class = link->info->class;
+		irq_sort_ents[i].info = link->info;
+		for (pass = 0; pass < IRQ_SORT_PASSES; pass++)
+			counts[pass][irq_sort_byte(&irq_sort_ents[i], pass)]++;
+	}
+
+	src = irq_sort_ents;
+	dst = irq_sort_tmp;
+	for (pass = 0; pass < IRQ_SORT_PASSES; pass++) {
+		if (counts[pass][irq_sort_byte(&src[0], pass)] == n)
+			continue;
+		for (b = 0, off = 0; b < 256; b++) {
+			c = counts[pass][b];
+			counts[pass][b] = off;
+			off += c;
+		}
+		for (i = 0; i < n; i++)
+			dst[counts[pass][irq_sort_byte(&src[i], pass)]++] = src[i];
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	/*źõ˳ӣжĿͼ*/
+	list->first = NULL;
+	for (i = 0; i < n; i++) {
+		link = irq_list_link(list, src[i].info);
+		link->prev = prev;
+		link->next = NULL;
+		if (prev)
+			prev->next = link;
+		else
+			list->first = link;
+		prev = link;
+	}
+	list->last = prev;
 }
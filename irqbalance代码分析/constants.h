@@ -4,6 +4,20 @@
 /* interval between rebalance attempts in seconds */
 #define SLEEP_INTERVAL 10
 
+/*
+ * Adaptive sampling: default bounds of the interval, in milliseconds.
+ * Sampling drops to the lower bound while the cpu irq loads are spread
+ * out (stddev/average) by IMBALANCE_THRESHOLD or more, or that spread
+ * moved by IMBALANCE_CHANGE since the last cycle, and otherwise backs
+ * off exponentially.  A box whose busiest cpu spends less than
+ * IDLE_IRQ_SHARE of its time in irqs always backs off.
+ */
+#define MIN_SAMPLE_INTERVAL	500
+#define MAX_SAMPLE_INTERVAL	30000
+#define IMBALANCE_THRESHOLD	0.5
+#define IMBALANCE_CHANGE	0.25
+#define IDLE_IRQ_SHARE		0.02
+
 #define NSEC_PER_SEC 1e9
 
 /* NUMA topology refresh intervals, in units of SLEEP_INTERVAL */
@@ -11,11 +25,29 @@
 /* NIC interrupt refresh interval, in units of SLEEP_INTERVAL */
 #define NIC_REFRESH_INTERVAL 32
 
+/*
+ * Default half-life, in milliseconds, of the moving averages the irq and
+ * cpu loads are smoothed with.  0 balances on each cycle's sample alone.
+ */
+#define LOAD_HALF_LIFE	10000
+
+/*
+ * Learning the cost of one interrupt of each irq: the step size of each
+ * cycle's correction, and the cycles to learn from before the learned
+ * cost replaces the irq's share of its cpus' time as its load
+ */
+#define IRQ_COST_STEP		0.5
+#define IRQ_COST_SAMPLES	8
+
 /* minimum number of interrupts since boot for an interrupt to matter */
 #define MIN_IRQ_COUNT	20
 
 
-/* balancing tunings */
+/*
+ * balancing tunings.  The penalties are charged by the placement cost
+ * function, in microseconds of irq time per second, and are scaled to
+ * the sampled period so they weigh against the loads at any interval.
+ */
 
 #define CROSS_PACKAGE_PENALTY		3000
 #define NUMA_PENALTY			500
@@ -24,6 +56,19 @@
 #define MSI_CACHE_PENALTY		10000
 #define CORE_SPECIFIC_THRESHOLD		5000
 
+/*
+ * Migration hysteresis.  An irq whose affinity was written less than
+ * MIGRATION_COOLDOWN ms ago is left alone unless its cpus went away, and
+ * an irq is only picked for rebalancing when that narrows the load gap by
+ * more than MIGRATION_COST, in the units of the penalties above.
+ */
+#define MIGRATION_COOLDOWN	5000
+#define MIGRATION_COST		2000
+
+/* numa distances the kernel reports for a node itself and, by default, the others */
+#define LOCAL_DISTANCE	10
+#define REMOTE_DISTANCE	20
+
 /* power mode */
 
 #define POWER_MODE_SOFTIRQ_THRESHOLD	20
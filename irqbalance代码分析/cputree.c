@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
 
 #include <glib.h>
 
@@ -16,6 +17,16 @@ GList *cpus;
 GList *cache_domains;
 GList *packages;
 
+/* Lookup arrays for the lists above, indexed by topo_obj number */
+static struct topo_index cpu_index;
+static struct topo_index cache_domain_index;
+static struct topo_index package_index;
+
+/* Memory the objects of each level are allocated from */
+static struct obj_pool cpu_pool = OBJ_POOL_INIT(struct topo_obj);
+static struct obj_pool cache_domain_pool = OBJ_POOL_INIT(struct topo_obj);
+static struct obj_pool package_pool = OBJ_POOL_INIT(struct topo_obj);
+
 int package_count;
 int cache_domain_count;
 int core_count;
@@ -25,12 +36,108 @@ cpumask_t banned_cpus;
 
 cpumask_t cpu_possible_map;
 
+/* Width of the cpumask operations, see cpumask.h */
+int nr_cpumask_bits = NR_CPUS;
+
+/* Every cpu that was online at the last (re)scan, banned ones included */
+static cpumask_t online_cpus;
+
+/* Cache domains are numbered in creation order, numbers are not reused */
+static int next_cache_number;
+
 /* 
    it's convenient to have the complement of banned_cpus available so that 
    the AND operator can be used to mask out unwanted cpus
 */
 cpumask_t unbanned_cpus;
 
+/*
+ * Size the cpumask operations to the possible cpus, read from the last
+ * cpu number in /sys/devices/system/cpu/possible and rounded up to whole
+ * words.  Masks stay NR_CPUS wide if it can't be read.
+ */
+void init_cpumask_bits(void)
+{
+	char buf[256], *last;
+	ssize_t len;
+	int fd, max;
+
+	fd = open("/sys/devices/system/cpu/possible", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	last = buf + strcspn(buf, "\n");
+	while (last > buf && last[-1] != '-' && last[-1] != ',')
+		last--;
+	max = strtol(last, NULL, 10);
+	if (max < 0 || max >= NR_CPUS)
+		return;
+
+	nr_cpumask_bits = ALIGN(max + 1, BITS_PER_LONG);
+	if (nr_cpumask_bits > NR_CPUS)
+		nr_cpumask_bits = NR_CPUS;
+	log(TO_CONSOLE, LOG_INFO, "cpumask operations cover %d cpus\n", nr_cpumask_bits);
+}
+
+/*飬ռ䲻ʱ2ݴ*/
+void topo_index_set(struct topo_index *idx, struct topo_obj *obj)
+{
+	struct topo_obj **objs;
+	int size;
+
+	if (obj->number < 0)
+		return;
+
+	if (obj->number >= idx->size) {
+		size = idx->size ? idx->size : 64;
+		while (size <= obj->number)
+			size <<= 1;
+		objs = realloc(idx->objs, size * sizeof(struct topo_obj *));
+		if (!objs) {
+			log(TO_CONSOLE, LOG_WARNING, "No memory to index object %d\n", obj->number);
+			return;
+		}
+		memset(&objs[idx->size], 0, (size - idx->size) * sizeof(struct topo_obj *));
+		idx->objs = objs;
+		idx->size = size;
+	}
+
+	if (!idx->objs[obj->number])
+		idx->count++;
+	idx->objs[obj->number] = obj;
+}
+
+/*ݱв*/
+struct topo_obj *topo_index_get(struct topo_index *idx, int number)
+{
+	if (number < 0 || number >= idx->size)
+		return NULL;
+	return idx->objs[number];
+}
+
+/*ɾ*/
+static void topo_index_del(struct topo_index *idx, struct topo_obj *obj)
+{
+	if (topo_index_get(idx, obj->number) != obj)
+		return;
+	idx->objs[obj->number] = NULL;
+	idx->count--;
+}
+
+/*ͷ*/
+void topo_index_clear(struct topo_index *idx)
+{
+	free(idx->objs);
+	idx->objs = NULL;
+	idx->size = 0;
+	idx->count = 0;
+}
+
 /*cache_domain뵽ָpackageУpackageidpackagepackageβһ
 packageidpackage򣬲cache_domain*/
 static struct topo_obj* add_cache_domain_to_package(struct topo_obj *cache, 
@@ -38,23 +145,28 @@ static struct topo_obj* add_cache_domain_to_package(struct topo_obj *cache,
 {
 	GList *entry;
 	struct topo_obj *package;
-	struct topo_obj *lcache; 
 
-	/*packageidpackageǷѾ*/
-	entry = g_list_first(packages);
-	while (entry) {
-		package = entry->data;
-		if (cpus_equal(package_mask, package->mask)) {
-			if (packageid != package->number)
-				log(TO_ALL, LOG_WARNING, "package_mask with different physical_package_id found!\n");
-			break;
+	/*packageidpackageǷѾڣȰŲ飬ŶӦ
+	벻ཻʱٱpackageCPUʱpackage뻹
+	ֻҪཻ*/
+	package = topo_index_get(&package_index, packageid);
+	if (!package || !cpus_intersects(package_mask, package->mask)) {
+		package = NULL;
+		entry = g_list_first(packages);
+		while (entry) {
+			if (cpus_intersects(package_mask, ((struct topo_obj *)entry->data)->mask)) {
+				package = entry->data;
+				if (packageid != package->number)
+					log(TO_ALL, LOG_WARNING, "package_mask with different physical_package_id found!\n");
+				break;
+			}
+			entry = g_list_next(entry);
 		}
-		entry = g_list_next(entry);
 	}
 
-	/*packageûҵָpackage½һnumberΪpackageidpackage*/
-	if (!entry) {
-		package = calloc(sizeof(struct topo_obj), 1);
+	/*ûҵָpackage½һnumberΪpackageidpackage*/
+	if (!package) {
+		package = obj_pool_alloc(&package_pool);
 		if (!package)
 			return NULL;
 		package->mask = package_mask;
@@ -62,20 +174,13 @@ static struct topo_obj* add_cache_domain_to_package(struct topo_obj *cache,
 		package->obj_type_list = &packages;
 		package->number = packageid;
 		packages = g_list_append(packages, package);
+		if (!topo_index_get(&package_index, packageid))
+			topo_index_set(&package_index, package);
 		package_count++;
 	}
 
-	/*cacheǷѾpackage*/
-	entry = g_list_first(package->children);
-	while (entry) {
-		lcache = entry->data;
-		if (lcache == cache)
-			break;
-		entry = g_list_next(entry);
-	}
-
-	/*cacheʱָpackage*/
-	if (!entry) {
+	/*cacheĸǸpackageʱ˵ϣָpackage*/
+	if (cache->parent != package) {
 		package->children = g_list_append(package->children, cache);
 		cache->parent = package;
 	}
@@ -90,38 +195,31 @@ static struct topo_obj* add_cpu_to_cache_domain(struct topo_obj *cpu,
 {
 	GList *entry;
 	struct topo_obj *cache;
-	struct topo_obj *lcpu;
 
 	entry = g_list_first(cache_domains);
 
+	/*packageֻͬҪཻ*/
 	while (entry) {
 		cache = entry->data;
-		if (cpus_equal(cache_mask, cache->mask))
+		if (cpus_intersects(cache_mask, cache->mask))
 			break;
 		entry = g_list_next(entry);
 	}
 
 	if (!entry) {
-		cache = calloc(sizeof(struct topo_obj), 1);
+		cache = obj_pool_alloc(&cache_domain_pool);
 		if (!cache)
 			return NULL;
 		cache->obj_type = OBJ_TYPE_CACHE;
 		cache->mask = cache_mask;
-		cache->number = cache_domain_count;
+		cache->number = next_cache_number++;
 		cache->obj_type_list = &cache_domains;
 		cache_domains = g_list_append(cache_domains, cache);
+		topo_index_set(&cache_domain_index, cache);
 		cache_domain_count++;
 	}
 
-	entry = g_list_first(cache->children);
-	while (entry) {
-		lcpu = entry->data;
-		if (lcpu == cpu)
-			break;
-		entry = g_list_next(entry);
-	}
-
-	if (!entry) {
+	if (cpu->parent != cache) {
 		cache->children = g_list_append(cache->children, cpu);
 		cpu->parent = (struct topo_obj *)cache;
 	}
@@ -129,6 +227,47 @@ static struct topo_obj* add_cpu_to_cache_domain(struct topo_obj *cpu,
 	return cache;
 }
 
+/*ȡCPUonlineļжǷߣûиļCPUߣ*/
+static int cpu_is_online(const char *path)
+{
+	char new_path[PATH_MAX];
+	char *line = NULL;
+	size_t size = 0;
+	FILE *file;
+	int online = 1;
+
+	snprintf(new_path, PATH_MAX, "%s/online", path);
+	file = fopen(new_path, "r");
+	if (!file)
+		return 1;
+	if (getline(&line, &size, file) > 0 && line[0] == '0')
+		online = 0;
+	fclose(file);
+	free(line);
+	return online;
+}
+
+/*жҪ׺Ͷ*/
+static void mark_irq_moved(struct irq_info *info, void *data __attribute__((unused)))
+{
+	info->moved = 1;
+}
+
+/*
+ * Widen obj and its ancestors to include cpunr.  Irqs already placed on
+ * an object whose mask grew get their affinity rewritten.
+ */
+static void add_cpu_to_ancestors(struct topo_obj *obj, int cpunr)
+{
+	for (; obj; obj = obj->parent) {
+		/*ûNUMAϢʱĽڵCPU*/
+		if (obj->number < 0 || cpu_isset(cpunr, obj->mask))
+			continue;
+		cpu_set(cpunr, obj->mask);
+		for_each_irq(&obj->interrupts, mark_irq_moved, NULL);
+	}
+}
+
 /*һCPU򣬲뵽ӦcachepackageԼCPU*/ 
 static void do_one_cpu(char *path)
 {
@@ -145,22 +284,10 @@ static void do_one_cpu(char *path)
 	unsigned int max_cache_index, cache_index, cache_stat;
 
 	/*ЩߵCPU */
-	snprintf(new_path, PATH_MAX, "%s/online", path);
-	file = fopen(new_path, "r");
-	if (file) {
-		char *line = NULL;
-		size_t size = 0;
-		if (getline(&line, &size, file)==0)
-			return;
-		fclose(file);
-		if (line && line[0]=='0') {
-			free(line);
-			return;
-		}
-		free(line);
-	}
+	if (!cpu_is_online(path))
+		return;
 
-	cpu = calloc(sizeof(struct topo_obj), 1);
+	cpu = obj_pool_alloc(&cpu_pool);
 	if (!cpu)
 		return;
 
@@ -170,13 +297,14 @@ static void do_one_cpu(char *path)
 
 	/*CPUøλͼ*/
 	cpu_set(cpu->number, cpu_possible_map);
+	cpu_set(cpu->number, online_cpus);
 	cpu_set(cpu->number, cpu->mask);
 	cpus_clear(cache_mask);
 	cpu_set(cpu->number, cache_mask);
 
 	/*CPUbannedCPU */
 	if (cpus_intersects(cpu->mask, banned_cpus)) {
-		free(cpu);
+		obj_pool_free(&cpu_pool, cpu);
 		/* even though we don't use the cpu we do need to count it */
 		core_count++;
 		return;
@@ -260,10 +388,13 @@ static void do_one_cpu(char *path)
 	cache = add_cpu_to_cache_domain(cpu, cache_mask);
 	package = add_cache_domain_to_package(cache, packageid, package_mask);
 	add_package_to_node(package, nodeid);
+	if (cache)
+		add_cpu_to_ancestors(cache, cpu->number);
 
 	cpu->obj_type_list = &cpus;
 	/*CPU뵽CPUṹ*/
 	cpus = g_list_append(cpus, cpu);
+	topo_index_set(&cpu_index, cpu);
 	core_count++;
 }
 
@@ -281,8 +412,8 @@ static void dump_topo_obj(struct topo_obj *d, void *data __attribute__((unused))
 	struct topo_obj *c = (struct topo_obj *)d;
 	log(TO_CONSOLE, LOG_INFO, "                CPU number %i  numa_node is %d (load %lu)\n",
 	    c->number, cpu_numa_node(c)->number , (unsigned long)c->load);
-	if (c->interrupts)
-		for_each_irq(c->interrupts, dump_irq, (void *)18);
+	if (c->interrupts.count)
+		for_each_irq(&c->interrupts, dump_irq, (void *)18);
 }
 
 static void dump_cache_domain(struct topo_obj *d, void *data)
@@ -293,8 +424,8 @@ static void dump_cache_domain(struct topo_obj *d, void *data)
 	    d->number, cache_domain_numa_node(d)->number, buffer, (unsigned long)d->load);
 	if (d->children)
 		for_each_object(d->children, dump_topo_obj, NULL);
-	if (g_list_length(d->interrupts) > 0)
-		for_each_irq(d->interrupts, dump_irq, (void *)10);
+	if (d->interrupts.count > 0)
+		for_each_irq(&d->interrupts, dump_irq, (void *)10);
 }
 
 static void dump_package(struct topo_obj *d, void *data)
@@ -305,8 +436,8 @@ static void dump_package(struct topo_obj *d, void *data)
 	    d->number, package_numa_node(d)->number, buffer, (unsigned long)d->load);
 	if (d->children)
 		for_each_object(d->children, dump_cache_domain, buffer);
-	if (g_list_length(d->interrupts) > 0)
-		for_each_irq(d->interrupts, dump_irq, (void *)2);
+	if (d->interrupts.count > 0)
+		for_each_irq(&d->interrupts, dump_irq, (void *)2);
 }
 
 void dump_tree(void)
@@ -325,7 +456,7 @@ static void clear_irq_stats(struct irq_info *info, void *data __attribute__((unu
 static void clear_obj_stats(struct topo_obj *d, void *data __attribute__((unused)))
 {
 	for_each_object(d->children, clear_obj_stats, NULL);
-	for_each_irq(d->interrupts, clear_irq_stats, NULL);
+	for_each_irq(&d->interrupts, clear_irq_stats, NULL);
 }
 
 /*һڴڵжϸؼ¼ */
@@ -373,7 +504,6 @@ void parse_cpu_tree(void)
 void clear_cpu_tree(void)
 {
 	GList *item;
-	struct topo_obj *cpu;
 	struct topo_obj *cache_domain;
 	struct topo_obj *package;
 
@@ -381,58 +511,177 @@ void clear_cpu_tree(void)
 		item = g_list_first(packages);
 		package = item->data;
 		g_list_free(package->children);
-		g_list_free(package->interrupts);
-		free(package);
 		packages = g_list_delete_link(packages, item);
 	}
+	topo_index_clear(&package_index);
+	obj_pool_reset(&package_pool);
 	package_count = 0;
 
 	while (cache_domains) {
 		item = g_list_first(cache_domains);
 		cache_domain = item->data;
 		g_list_free(cache_domain->children);
-		g_list_free(cache_domain->interrupts);
-		free(cache_domain);
 		cache_domains = g_list_delete_link(cache_domains, item);
 	}
+	topo_index_clear(&cache_domain_index);
+	obj_pool_reset(&cache_domain_pool);
 	cache_domain_count = 0;
+	next_cache_number = 0;
 
 
-	while (cpus) {
-		item = g_list_first(cpus);
-		cpu = item->data;
-		g_list_free(cpu->interrupts);
-		free(cpu);
-		cpus = g_list_delete_link(cpus, item);
-	}
+	g_list_free(cpus);
+	cpus = NULL;
+	topo_index_clear(&cpu_index);
+	obj_pool_reset(&cpu_pool);
 	core_count = 0;
+	cpus_clear(online_cpus);
 
 }
 
-/*ȽCPUһڱȽϣѰضCPU*/
-static gint compare_cpus(gconstpointer a, gconstpointer b)
+/*ϵжȫǨȴ·*/
+static void requeue_obj_irqs(struct topo_obj *obj)
 {
-	const struct topo_obj *ai = a;
-	const struct topo_obj *bi = b;
+	struct irq_info *info;
 
-	return ai->number - bi->number;	
+	while (obj->interrupts.first) {
+		info = obj->interrupts.first->info;
+		migrate_irq(&obj->interrupts, &rebalance_irq_list, info);
+		set_irq_obj(info, NULL);
+	}
+}
+
+/*
+ * Take cpunr out of the tree.  Its ancestors lose it from their masks
+ * and so get their irqs' affinity rewritten; a cache domain or package
+ * left without children is freed.  Irqs that sat on a freed object are
+ * queued for placement, numa nodes are kept even when they empty.
+ */
+static void remove_one_cpu(int cpunr)
+{
+	struct topo_obj *cpu, *obj, *parent;
+	struct obj_pool *pool;
+
+	cpu_clear(cpunr, online_cpus);
+	core_count--;
+
+	cpu = find_cpu_core(cpunr);
+	if (!cpu)
+		return;
+
+	for (obj = cpu->parent; obj; obj = obj->parent) {
+		if (obj->number < 0 || !cpu_isset(cpunr, obj->mask))
+			continue;
+		cpu_clear(cpunr, obj->mask);
+		for_each_irq(&obj->interrupts, mark_irq_moved, NULL);
+	}
+
+	obj = cpu;
+	while (obj && !obj->children) {
+		requeue_obj_irqs(obj);
+		*obj->obj_type_list = g_list_remove(*obj->obj_type_list, obj);
+		switch (obj->obj_type) {
+		case OBJ_TYPE_CPU:
+			topo_index_del(&cpu_index, obj);
+			pool = &cpu_pool;
+			break;
+		case OBJ_TYPE_CACHE:
+			topo_index_del(&cache_domain_index, obj);
+			cache_domain_count--;
+			pool = &cache_domain_pool;
+			break;
+		case OBJ_TYPE_PACKAGE:
+		default:
+			topo_index_del(&package_index, obj);
+			package_count--;
+			pool = &package_pool;
+			break;
+		}
+		parent = obj->parent;
+		if (parent)
+			parent->children = g_list_remove(parent->children, obj);
+		obj_pool_free(pool, obj);
+		obj = (parent && parent->obj_type != OBJ_TYPE_NODE) ? parent : NULL;
+	}
+}
+
+/*
+ * Bring the tree in line with the cpus online now.  Only the cpus that
+ * went offline or came online are touched, everything else, with the
+ * irqs placed on it, stays as it is.  Returns the number of cpus that
+ * changed, or -1 if the cpus could not be listed.
+ */
+int update_cpu_tree(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+	cpumask_t online;
+	char path[PATH_MAX];
+	int num, changed = 0;
+	char pad;
+
+	dir = opendir("/sys/devices/system/cpu");
+	if (!dir)
+		return -1;
+
+	cpus_clear(online);
+	while ((entry = readdir(dir))) {
+		if (sscanf(entry->d_name, "cpu%d%c", &num, &pad) != 1 ||
+		    num < 0 || num >= NR_CPUS)
+			continue;
+		snprintf(path, PATH_MAX, "/sys/devices/system/cpu/%s", entry->d_name);
+		if (cpu_is_online(path))
+			cpu_set(num, online);
+	}
+	closedir(dir);
+
+	for (num = 0; num < NR_CPUS; num++) {
+		if (cpu_isset(num, online_cpus) && !cpu_isset(num, online)) {
+			log(TO_CONSOLE, LOG_INFO, "cpu %d went offline\n", num);
+			remove_one_cpu(num);
+			changed++;
+		}
+	}
+
+	for (num = 0; num < NR_CPUS; num++) {
+		if (!cpu_isset(num, online_cpus) && cpu_isset(num, online)) {
+			log(TO_CONSOLE, LOG_INFO, "cpu %d came online\n", num);
+			snprintf(path, PATH_MAX, "/sys/devices/system/cpu/cpu%d", num);
+			do_one_cpu(path);
+			changed++;
+		}
+	}
+
+	if (debug_mode && changed)
+		dump_tree();
+	return changed;
 }
 
 /*ҵָCPU򷵻ṹϢ򷵻ؿ*/
 struct topo_obj *find_cpu_core(int cpunr)
 {
-	GList *entry;
-	struct topo_obj find;
+	return topo_index_get(&cpu_index, cpunr);
+}
 
-	find.number = cpunr;
-	entry = g_list_find_custom(cpus, &find, compare_cpus);
+/*ݱҵcache*/
+struct topo_obj *find_cache_domain(int number)
+{
+	return topo_index_get(&cache_domain_index, number);
+}
 
-	return entry ? entry->data : NULL;
-}	
+/*ݱҵpackage*/
+struct topo_obj *find_package(int number)
+{
+	return topo_index_get(&package_index, number);
+}
 
 /*ȡCPUĿ*/
 int get_cpu_count(void)
 {
-	return g_list_length(cpus);
+	return cpu_index.count;
 }
 
+/*˽ṹʱߵCPUĿbanCPU*/
+int get_online_cpu_count(void)
+{
+	return cpus_weight(online_cpus);
+}
@@ -218,6 +218,21 @@ g_list_free_full (GList          *list,
   g_list_free (list);
 }
 
+/*ҵָһµԪ*/
+GList*
+g_list_find (GList         *list,
+	     gconstpointer  data)
+{
+  while (list)
+    {
+      if (list->data == data)
+		break;
+      list = list->next;
+    }
+
+  return list;
+}
+
 /*ݲеĹܺҵҪԪ*/
 GList*
 g_list_find_custom (GList         *list,
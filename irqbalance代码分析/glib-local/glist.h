@@ -32,6 +32,7 @@ GList*   g_list_append                  (GList            *list,
 GList*   g_list_delete_link             (GList            *list,
 					 GList            *link_);
 GList*   g_list_first                   (GList            *list);
+GList*   g_list_last                    (GList            *list);
 GList*   g_list_sort                    (GList            *list,
 					 GCompareFunc      compare_func);
 guint    g_list_length                  (GList            *list);
@@ -40,6 +41,8 @@ void     g_list_foreach                 (GList            *list,
 					 gpointer          user_data);
 void     g_list_free_full               (GList            *list,
 					 GDestroyNotify    free_func);
+GList*   g_list_find                    (GList            *list,
+					 gconstpointer     data);
 GList*   g_list_find_custom             (GList            *list,
 					 gconstpointer     data,
 					 GCompareFunc      func);
@@ -10,6 +10,9 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
 #include <fcntl.h>
 #ifdef HAVE_GETOPT_LONG 
 #include <getopt.h>
@@ -24,35 +27,231 @@ volatile int keep_going = 1;
 int one_shot_mode;
 int debug_mode;
 int foreground_mode;
+int tracefs_mode;
 int numa_avail;
 int need_rescan;
+/* Set when the topology must be rebuilt from scratch rather than updated */
+static int need_full_rescan;
 unsigned int log_mask = TO_ALL;
 enum hp_e global_hint_policy = HINT_POLICY_IGNORE;
 unsigned long power_thresh = ULONG_MAX;
+unsigned long solver_budget = 0;
+unsigned long load_half_life = LOAD_HALF_LIFE;
 unsigned long deepest_cache = 2;
 unsigned long long cycle_count = 0;
 char *pidfile = NULL;
 char *banscript = NULL;
 char *polscript = NULL;
 long HZ;
+unsigned long min_interval = MIN_SAMPLE_INTERVAL;
+unsigned long max_interval = MAX_SAMPLE_INTERVAL;
+unsigned long sample_interval = SLEEP_INTERVAL * 1000;
 
-/*ֻܻͣ΢ȼľȷ*/
-static void sleep_approx(int seconds)
+/*
+ * The main loop waits in epoll_wait() on a set of event sources: the
+ * sampling timerfd, a signalfd for SIGINT/SIGTERM/SIGHUP, and whatever
+ * else registers through add_event_source().  A cycle runs when the
+ * timer fires or a rescan is requested.
+ */
+#define MAX_EVENTS 16
+
+struct event_source {
+	int fd;
+	event_handler_t handler;
+	void *data;
+};
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int signal_fd = -1;
+static GList *event_sources = NULL;
+static int cycle_due;
+
+/*fdѭȴ¼ԴУfdʱhandlerɹ0*/
+int add_event_source(int fd, uint32_t events, event_handler_t handler, void *data)
+{
+	struct event_source *src;
+	struct epoll_event ev;
+
+	src = calloc(1, sizeof(struct event_source));
+	if (!src)
+		return -1;
+	src->fd = fd;
+	src->handler = handler;
+	src->data = data;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = src;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+		free(src);
+		return -1;
+	}
+	event_sources = g_list_append(event_sources, src);
+	return 0;
+}
+
+/*fdѭ¼ԴƳ*/
+void remove_event_source(int fd)
+{
+	struct event_source *src;
+	GList *entry;
+
+	for (entry = g_list_first(event_sources); entry; entry = g_list_next(entry)) {
+		src = entry->data;
+		if (src->fd != fd)
+			continue;
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		event_sources = g_list_delete_link(event_sources, entry);
+		free(src);
+		return;
+	}
+}
+
+/*ʱڣʼµһֲ*/
+static void timer_expired(int fd, uint32_t events __attribute__((unused)),
+			  void *data __attribute__((unused)))
+{
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+		cycle_due = 1;
+}
+
+/*źţSIGINTSIGTERMʹ˳SIGHUPҪ½˽ṹ*/
+static void signal_received(int fd, uint32_t events __attribute__((unused)),
+			    void *data __attribute__((unused)))
+{
+	struct signalfd_siginfo si;
+
+	while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+		switch (si.ssi_signo) {
+		case SIGINT:
+		case SIGTERM:
+			keep_going = 0;
+			break;
+		case SIGHUP:
+			if (cycle_count)
+				need_rescan = need_full_rescan = 1;
+			break;
+		}
+	}
+}
+
+/*Ҫѭʼµһֲ*/
+void request_cycle(void)
+{
+	cycle_due = 1;
+}
+
+/*
+ * Block the signals we take through the signalfd.  Done before any
+ * thread is started so that no thread gets them delivered.
+ */
+static void block_signals(sigset_t *mask)
+{
+	sigemptyset(mask);
+	sigaddset(mask, SIGINT);
+	sigaddset(mask, SIGTERM);
+	sigaddset(mask, SIGHUP);
+	sigprocmask(SIG_BLOCK, mask, NULL);
+}
+
+/*epollʵʱźfdʧܷ-1*/
+static int init_event_loop(sigset_t *mask)
+{
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		return -1;
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd < 0 || add_event_source(timer_fd, EPOLLIN, timer_expired, NULL))
+		return -1;
+
+	signal_fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd < 0 || add_event_source(signal_fd, EPOLLIN, signal_received, NULL))
+		return -1;
+	return 0;
+}
+
+/*رѭʹõfd*/
+static void free_event_loop(void)
+{
+	while (event_sources)
+		remove_event_source(((struct event_source *)event_sources->data)->fd);
+	if (signal_fd >= 0)
+		close(signal_fd);
+	if (timer_fd >= 0)
+		close(timer_fd);
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	signal_fd = timer_fd = epoll_fd = -1;
+}
+
+/*
+ * Arm the sampling timer for ms milliseconds and dispatch events until
+ * it fires, a rescan is requested or we are told to exit.  A rescan that
+ * was already pending when we got here, one that did not settle, does
+ * not cut the wait short, or the main loop would spin on it.
+ */
+static void wait_for_cycle(unsigned long ms)
 {
-	struct timespec ts;	//벿
-	struct timeval tv;	//΢벿
-	/*ȡʱ亯ȷ΢뼶*/
-	gettimeofday(&tv, NULL);
-
-	/*tv_secΪ֣tv_usecΪ΢*/
-	ts.tv_sec = seconds;
-	ts.tv_nsec = -tv.tv_usec*1000;
-	while (ts.tv_nsec < 0) {
-		ts.tv_sec--;
-		ts.tv_nsec += 1000000000;
+	struct epoll_event events[MAX_EVENTS];
+	struct itimerspec its;
+	struct event_source *src;
+	int i, n, rescan_pending = need_rescan;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = ms / 1000;
+	its.it_value.tv_nsec = (ms % 1000) * 1000000;
+	timerfd_settime(timer_fd, 0, &its, NULL);
+
+	cycle_due = 0;
+	while (keep_going && !cycle_due && (rescan_pending || !need_rescan)) {
+		n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		for (i = 0; i < n; i++) {
+			src = events[i].data.ptr;
+			src->handler(src->fd, events[i].events, src->data);
+		}
 	}
-	//̣֪ͣ趨ʱ
-	nanosleep(&ts, NULL);
+}
+
+/*
+ * Pick the next sampling interval from how unevenly the irq load was
+ * spread over the cpus this cycle: drop to min_interval while it is
+ * uneven or changing, else double the interval up to max_interval
+ */
+static void update_sample_interval(void)
+{
+	static long double last_spread = 0;
+	long double std_deviation, spread = 0, change, busy;
+	uint64_t avg, max;
+	unsigned long next;
+
+	get_cpu_load_spread(&avg, &max, &std_deviation);
+	if (avg)
+		spread = std_deviation / avg;
+	change = spread > last_spread ? spread - last_spread : last_spread - spread;
+	last_spread = spread;
+	/*æCPUжϵʱռڵı*/
+	busy = (long double)max / ((long double)sample_interval * 1000000);
+
+	if (busy >= IDLE_IRQ_SHARE &&
+	    (spread >= IMBALANCE_THRESHOLD || change >= IMBALANCE_CHANGE))
+		next = min_interval;
+	else
+		next = sample_interval * 2;
+	if (next > max_interval)
+		next = max_interval;
+	if (next < min_interval)
+		next = min_interval;
+
+	log(TO_CONSOLE, LOG_INFO, "Next sampling interval %lu ms (load spread %.2Lf, change %.2Lf, busiest cpu %.1Lf%% in irqs)\n",
+	    next, spread, change, busy * 100);
+	if (next != sample_interval)
+		log(TO_SYSLOG, LOG_DEBUG, "Sampling interval changed from %lu ms to %lu ms\n",
+		    sample_interval, next);
+	sample_interval = next;
 }
 
 #ifdef HAVE_GETOPT_LONG
@@ -67,6 +266,11 @@ struct option lopts[] = {
 	{"deepestcache", 1, NULL, 'c'},
 	{"policyscript", 1, NULL, 'l'},
 	{"pid", 1, NULL, 's'},
+	{"tracefs", 0, NULL, 't'},
+	{"mininterval", 1, NULL, 'm'},
+	{"maxinterval", 1, NULL, 'M'},
+	{"solverbudget", 1, NULL, 'S'},
+	{"halflife", 1, NULL, 'H'},
 	{0, 0, 0, 0}
 };
 
@@ -74,6 +278,8 @@ static void usage(void)
 {
 	log(TO_CONSOLE, LOG_INFO, "irqbalance [--oneshot | -o] [--debug | -d] [--foreground | -f] [--hintpolicy= | -h [exact|subset|ignore]]\n");
 	log(TO_CONSOLE, LOG_INFO, "	[--powerthresh= | -p <off> | <n>] [--banirq= | -i <n>] [--policyscript=<script>] [--pid= | -s <file>] [--deepestcache= | -c <n>]\n");
+	log(TO_CONSOLE, LOG_INFO, "	[--tracefs | -t] [--mininterval= | -m <ms>] [--maxinterval= | -M <ms>] [--solverbudget= | -S <ms>]\n");
+	log(TO_CONSOLE, LOG_INFO, "	[--halflife= | -H <ms>]\n");
 }
 
 /**/
@@ -84,7 +290,7 @@ static void parse_command_line(int argc, char **argv)
 	unsigned long val;
 
 	while ((opt = getopt_long(argc, argv,
-		"odfh:i:p:s:c:b:l:",
+		"odfth:i:p:s:c:b:l:m:M:S:H:",
 		lopts, &longind)) != -1) {
 
 		switch(opt) {
@@ -141,6 +347,34 @@ static void parse_command_line(int argc, char **argv)
 			case 'l':
 				polscript = strdup(optarg);
 				break;
+			case 'm':
+				min_interval = strtoul(optarg, NULL, 10);
+				if (min_interval == ULONG_MAX || min_interval < 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'M':
+				max_interval = strtoul(optarg, NULL, 10);
+				if (max_interval == ULONG_MAX || max_interval < 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'H':
+				load_half_life = strtoul(optarg, NULL, 10);
+				if (load_half_life == ULONG_MAX) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'S':
+				solver_budget = strtoul(optarg, NULL, 10);
+				if (solver_budget == ULONG_MAX) {
+					usage();
+					exit(1);
+				}
+				break;
 			case 'p':
 				if (!strncmp(optarg, "off", strlen(optarg)))
 					power_thresh = ULONG_MAX;
@@ -158,6 +392,9 @@ static void parse_command_line(int argc, char **argv)
 			case 's':
 				pidfile = optarg;
 				break;
+			case 't':
+				tracefs_mode=1;
+				break;
 		}
 	}
 }
@@ -193,39 +430,26 @@ static void force_rebalance_irq(struct irq_info *info, void *data __attribute__(
 		return;
 
 	if (info->assigned_obj == NULL)
-		rebalance_irq_list = g_list_append(rebalance_irq_list, info);
+		irq_list_append(&rebalance_irq_list, info);
 	else
 		migrate_irq(&info->assigned_obj->interrupts, &rebalance_irq_list, info);
 
-	info->assigned_obj = NULL;
+	set_irq_obj(info, NULL);
 }
 
-static void handler(int signum)
+/*½˽ṹж·*/
+static void rescan_object_tree(void)
 {
-	(void)signum;
-	keep_going = 0;
-}
-
-/*趨½˽ṹı־λ*/
-static void force_rescan(int signum)
-{
-	(void)signum;
-	if (cycle_count)
-		need_rescan = 1;
+	log(TO_CONSOLE, LOG_INFO, "Rescanning cpu topology \n");
+	free_object_tree();
+	build_object_tree();
+	for_each_irq(NULL, force_rebalance_irq, NULL);
 }
 
 int main(int argc, char** argv)
 {
-	struct sigaction action, hupaction;
-/*
-struct sigaction {
-	void (*sa_handler)(int); //źŴ
-	void (*sa_sigaction)(int, siginfo_t *, void *);
-	sigset_t sa_mask;  //ڴźʱʱsa_mask ָźż
-	int sa_flags;		//źŴز
-	void (*sa_restorer)(void);	δʹøò
-}
-*/
+	sigset_t sigmask;
+	int changed, fallback_done = 0;
 
 #ifdef HAVE_GETOPT_LONG
 	parse_command_line(argc, argv);
@@ -241,6 +465,16 @@ struct sigaction {
 		one_shot_mode=1;
 #endif
 
+	/*޲ܴޣʼ֮*/
+	if (min_interval > max_interval) {
+		log(TO_CONSOLE, LOG_WARNING, "--mininterval must not be larger than --maxinterval\n");
+		exit(EXIT_FAILURE);
+	}
+	if (sample_interval < min_interval)
+		sample_interval = min_interval;
+	if (sample_interval > max_interval)
+		sample_interval = max_interval;
+
 	/*
  	 * Open the syslog connection
  	 */
@@ -263,6 +497,9 @@ struct sigaction {
 	if (!debug_mode)
 		log_mask &= ~TO_CONSOLE;
 
+	/*λͼֻ踲ϵͳпܴڵCPU*/
+	init_cpumask_bits();
+
 	if (numa_available() > -1) {
 		numa_avail = 1;
 	} else 
@@ -279,10 +516,8 @@ struct sigaction {
 		HZ = 100;
 	}
 
-	action.sa_handler = handler;
-	sigemptyset(&action.sa_mask);	//մźż
-	action.sa_flags = 0;
-	sigaction(SIGINT, &action, NULL);	//źŴʽSIGINT   Լ̵жź ( ctrl + c ) .
+	/*SIGINTSIGTERMSIGHUP첽ͨsignalfdѭжȡ*/
+	block_signals(&sigmask);
 
 	/*˽ṹ*/
 	build_object_tree();
@@ -315,6 +550,16 @@ struct sigaction {
 		}
 	}
 
+	if (init_event_loop(&sigmask)) {
+		log(TO_ALL, LOG_WARNING, "Unable to set up the event loop, exiting\n");
+		exit(EXIT_FAILURE);
+	}
+
+	init_uevent_listener();
+
+	/*̲߳ܿԽforkڽ̨֮*/
+	if (tracefs_mode)
+		init_irq_trace();
 
 #ifdef HAVE_LIBCAP_NG
 	// Drop capabilities
@@ -325,17 +570,15 @@ struct sigaction {
 
 	for_each_irq(NULL, force_rebalance_irq, NULL);
 
+	init_irq_sampler();
 	parse_proc_interrupts();
 	parse_proc_stat();
 
-	hupaction.sa_handler = force_rescan;	//øźŵĴ
-	sigemptyset(&hupaction.sa_mask);
-	hupaction.sa_flags = 0;
-	sigaction(SIGHUP, &hupaction, NULL);  // SIGHUP նϷĽź.
-
 	while (keep_going) {
-		/*мΪ10s*/
-		sleep_approx(SLEEP_INTERVAL);
+		/*мһڵĸ֮յźʱ*/
+		wait_for_cycle(sample_interval);
+		if (!keep_going)
+			break;
 		log(TO_CONSOLE, LOG_INFO, "\n\n\n-----------------------------------------------------------------------------\n");
 
 
@@ -343,26 +586,54 @@ struct sigaction {
 		parse_proc_interrupts();
 		parse_proc_stat();
 
-		/* Ҫ½˽ṹִһγʼ */
+		/* CPU˷仯ֻ±仯CPUյSIGHUP޷Ƚʱִһγʼ */
 		if (need_rescan) {
 			need_rescan = 0;
 			cycle_count = 0;
-			log(TO_CONSOLE, LOG_INFO, "Rescanning cpu topology \n");
 			clear_work_stats();
 
-			free_object_tree();
-			build_object_tree();
-			for_each_irq(NULL, force_rebalance_irq, NULL);
+			changed = need_full_rescan ? -1 : update_cpu_tree();
+			if (changed < 0) {
+				need_full_rescan = 0;
+				rescan_object_tree();
+			} else {
+				log(TO_CONSOLE, LOG_INFO, "Updated cpu topology in place\n");
+				rebase_irq_counts();
+			}
 			parse_proc_interrupts();
 			parse_proc_stat();
-			sleep_approx(SLEEP_INTERVAL);
+
+			/*
+			 * Nothing changed in place but the samples still don't
+			 * match the tree: rebuild it, once.  If even that does
+			 * not settle it, the mismatch is not in the topology;
+			 * keep the current tree and only retry in place, once
+			 * a cycle, until a rescan settles.
+			 */
+			if (!changed && need_rescan) {
+				if (!fallback_done) {
+					fallback_done = 1;
+					need_rescan = 0;
+					rescan_object_tree();
+					parse_proc_interrupts();
+					parse_proc_stat();
+				} else
+					log(TO_CONSOLE, LOG_INFO, "Samples still don't match the cpu topology, keeping it\n");
+			}
+			if (!need_rescan)
+				fallback_done = 0;
+			wait_for_cycle(min_interval);
+			if (!keep_going)
+				break;
 			clear_work_stats();
 			parse_proc_interrupts();
 			parse_proc_stat();
 		} 
 
-		if (cycle_count)	
+		if (cycle_count) {
 			update_migration_status();
+			update_sample_interval();
+		}
 
 		calculate_placement();
 		activate_mappings();
@@ -374,7 +645,10 @@ struct sigaction {
 		cycle_count++;
 
 	}
+	stop_irq_trace();
+	stop_uevent_listener();
 	free_object_tree();
+	free_event_loop();
 
 	/* Remove pidfile */
 	if (!foreground_mode && pidfile)
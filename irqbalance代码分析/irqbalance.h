@@ -24,23 +24,62 @@ extern int core_count;
 extern char *classes[];
 
 extern void parse_cpu_tree(void);
+extern void init_cpumask_bits(void);
 extern void clear_work_stats(void);
+extern void init_irq_sampler(void);
 extern void parse_proc_interrupts(void);
-extern GList* collect_full_irq_list();
+extern void collect_full_irq_list(struct irq_list *list, struct obj_pool *pool);
+extern int grow_array(void **array, int *size, int needed, size_t elem_size);
+extern uint64_t monotonic_ns(void);
 extern void parse_proc_stat(void);
+extern uint64_t sample_period_ns;
+extern int irq_trace_active;
+extern int init_irq_trace(void);
+extern void stop_irq_trace(void);
+extern void irq_trace_snapshot(void);
+extern uint64_t irq_trace_irq_ns(int irq);
+extern uint64_t irq_trace_hardirq_ns(int cpu);
+extern uint64_t irq_trace_softirq_ns(int cpu, int vec);
 extern void set_interrupt_count(int number, uint64_t count);
 extern void set_msi_interrupt_numa(int number);
 
-extern GList *rebalance_irq_list;
+extern struct irq_list rebalance_irq_list;
+
+/*
+ * Event sources of the main loop
+ */
+typedef void (*event_handler_t)(int fd, uint32_t events, void *data);
+extern int add_event_source(int fd, uint32_t events, event_handler_t handler, void *data);
+extern void remove_event_source(int fd);
+extern void request_cycle(void);
+extern void init_uevent_listener(void);
+extern void stop_uevent_listener(void);
 
 void update_migration_status(void);
+void get_cpu_load_spread(uint64_t *avg, uint64_t *max, long double *std_deviation);
 void dump_workloads(void);
-void sort_irq_list(GList **list);
+void sort_irq_list(struct irq_list *list);
+extern void set_irq_obj(struct irq_info *info, struct topo_obj *obj);
+
+/* cost of placing an irq in an object, never below the object's load */
+typedef uint64_t (*placement_cost_fn)(struct topo_obj *d, struct irq_info *info);
+extern placement_cost_fn placement_cost;
 void calculate_placement(void);
 void dump_tree(void);
 
 void activate_mappings(void);
+
+/* irq moves of this cycle, and since the start, see activate.c */
+struct migration_stats {
+	unsigned int performed;
+	unsigned int cooling;		/* held back by the cooldown */
+	unsigned int unprofitable;	/* would gain less than MIGRATION_COST */
+	unsigned long long total_performed;
+	unsigned long long total_prevented;
+};
+extern struct migration_stats migration_stats;
 void clear_cpu_tree(void);
+extern int update_cpu_tree(void);
 
 /*===================NEW BALANCER FUNCTIONS============================*/
 
@@ -65,6 +104,8 @@ extern int need_rescan;
 extern enum hp_e global_hint_policy;
 extern unsigned long long cycle_count;
 extern unsigned long power_thresh;
+extern unsigned long solver_budget;
+extern unsigned long load_half_life;
 extern unsigned long deepest_cache;
 extern char *banscript;
 extern char *polscript;
@@ -80,6 +121,7 @@ extern void free_numa_node_list(void);
 extern void dump_numa_node_info(struct topo_obj *node, void *data);
 extern void add_package_to_node(struct topo_obj *p, int nodeid);
 extern struct topo_obj *get_numa_node(int nodeid);
+extern int numa_distance(int from, int to);
 
 /*
  * Package functions
@@ -100,6 +142,24 @@ extern struct topo_obj *get_numa_node(int nodeid);
 #define cpu_numa_node(cpu) (package_numa_node(cache_domain_package(cpu_cache_domain((cpu)))))
 extern struct topo_obj *find_cpu_core(int cpunr);
 extern int get_cpu_count(void);
+extern int get_online_cpu_count(void);
+
+/*
+ * Object index functions
+ */
+extern void topo_index_set(struct topo_index *idx, struct topo_obj *obj);
+extern struct topo_obj *topo_index_get(struct topo_index *idx, int number);
+extern void topo_index_clear(struct topo_index *idx);
+extern struct topo_obj *find_cache_domain(int number);
+extern struct topo_obj *find_package(int number);
+
+/*
+ * Object pool functions
+ */
+extern void *obj_pool_alloc(struct obj_pool *pool);
+extern void obj_pool_free(struct obj_pool *pool, void *obj);
+extern void obj_pool_reset(struct obj_pool *pool);
+extern void obj_pool_release(struct obj_pool *pool);
 
 /*
  * irq db functions
@@ -107,9 +167,15 @@ extern int get_cpu_count(void);
 extern void rebuild_irq_db(void);
 extern void free_irq_db(void);
 extern void add_cl_banned_irq(int irq);
-extern void for_each_irq(GList *list, void (*cb)(struct irq_info *info,  void *data), void *data);
+extern void for_each_irq(struct irq_list *list, void (*cb)(struct irq_info *info,  void *data), void *data);
+extern void for_each_banned_irq(void (*cb)(struct irq_info *info, void *data), void *data);
 extern struct irq_info *get_irq_info(int irq);
-extern void migrate_irq(GList **from, GList **to, struct irq_info *info);
+extern void migrate_irq(struct irq_list *from, struct irq_list *to, struct irq_info *info);
+extern struct irq_info *add_new_irq_incremental(struct irq_info *hint, int *devices_scanned);
+extern void remove_irq_from_db(struct irq_info *info);
+extern void retire_stale_irqs(uint64_t generation);
+extern int add_pci_device_irqs(const char *dirname);
+extern void rebase_irq_counts(void);
 #define irq_numa_node(irq) ((irq)->numa_node)
 
 
@@ -127,6 +193,101 @@ static inline void for_each_object(GList *list, void (*cb)(struct topo_obj *obj,
 	}
 }
 
+/*
+ * Irq list functions
+ */
+static inline void irq_list_init(struct irq_list *list, int db)
+{
+	list->first = list->last = NULL;
+	list->count = 0;
+	list->db = db;
+	list->delta = 0;
+}
+
+static inline struct irq_link *irq_list_link(struct irq_list *list, struct irq_info *info)
+{
+	return list->db ? &info->db_link : &info->link;
+}
+
+/*жڱڵĴ*/
+static inline uint64_t irq_count_delta(struct irq_info *info)
+{
+	return info->irq_count - info->last_irq_count;
+}
+
+/*жϴժڸʱʲôҲ*/
+static inline void irq_list_del(struct irq_list *list, struct irq_info *info)
+{
+	struct irq_link *link = irq_list_link(list, info);
+
+	if (link->list != list)
+		return;
+	if (link->prev)
+		link->prev->next = link->next;
+	else
+		list->first = link->next;
+	if (link->next)
+		link->next->prev = link->prev;
+	else
+		list->last = link->prev;
+	link->next = link->prev = NULL;
+	link->list = NULL;
+	list->count--;
+	list->delta -= irq_count_delta(info);
+}
+
+/*жϼβԭͬʱȴժ*/
+static inline void irq_list_append(struct irq_list *list, struct irq_info *info)
+{
+	struct irq_link *link = irq_list_link(list, info);
+
+	if (link->list)
+		irq_list_del(link->list, info);
+	link->info = info;
+	link->list = list;
+	link->next = NULL;
+	link->prev = list->last;
+	if (list->last)
+		list->last->next = link;
+	else
+		list->first = link;
+	list->last = link;
+	list->count++;
+	list->delta += irq_count_delta(info);
+}
+
+/*жϵļͬʱļ֮*/
+static inline void irq_set_counts(struct irq_info *info, uint64_t last, uint64_t count)
+{
+	uint64_t old = irq_count_delta(info);
+
+	info->last_irq_count = last;
+	info->irq_count = count;
+	if (info->link.list)
+		info->link.list->delta += irq_count_delta(info) - old;
+	if (info->db_link.list)
+		info->db_link.list->delta += irq_count_delta(info) - old;
+}
+
+/*ÿ΢ƵĳͷΪڵ룬븺ؿɱ*/
+static inline uint64_t scale_penalty(uint64_t cost)
+{
+	return cost * sample_period_ns / 1000000;
+}
+
+/*жϵ׺Ͷȸոдȴ*/
+static inline int irq_cooling_down(struct irq_info *info)
+{
+	return info->moved_ns &&
+	       monotonic_ns() - info->moved_ns < MIGRATION_COOLDOWN * 1000000ULL;
+}
+
+/*ǨmovesжʹߵĸزСgapǷ񳬹ǨƱĴ*/
+static inline int migration_profitable(uint64_t gap, int moves)
+{
+	return gap > moves * scale_penalty(MIGRATION_COST);
+}
+
 /*
  * Logging functions
  */
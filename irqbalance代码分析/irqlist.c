@@ -14,9 +14,10 @@ struct load_balance_info {
 	unsigned long long int total_load;  //ϵͳжϸ
 	unsigned long long avg_load;	//ϵͳƽжϸ
 	unsigned long long min_load;	//ϵͳежϸСֵ
+	unsigned long long max_load;	//ϵͳежϸֵ
 	unsigned long long adjustment_load; //¼Ǩжϵܸ
 	int load_sources;	//
-	unsigned long long int deviations;	//ֵ
+	long double deviations;	//ֵƽͣ뼶صƽᳬ64λ
 	long double std_deviation;	
 	unsigned int num_over;	//ƽص
 	unsigned int num_under;	//ƽص
@@ -31,6 +32,8 @@ static void gather_load_stats(struct topo_obj *obj, void *data)
 
 	if (info->min_load == 0 || obj->load < info->min_load)
 		info->min_load = obj->load;
+	if (obj->load > info->max_load)
+		info->max_load = obj->load;
 	info->total_load += obj->load;
 	info->load_sources += 1;
 }
@@ -45,7 +48,7 @@ static void compute_deviations(struct topo_obj *obj, void *data)
 		obj->load - info->avg_load :
 		info->avg_load - obj->load;
 
-	info->deviations += (deviation * deviation);
+	info->deviations += (long double)deviation * deviation;
 }
 
 /*жжǷǨҪԭжɾ*/
@@ -65,7 +68,7 @@ static void move_candidate_irqs(struct irq_info *info, void *data)
 		return;
 
 	/*ж󶨵CPUֻһжϣжϴĸضأǨƸж */
-	if (g_list_length(info->assigned_obj->interrupts) <= 1)
+	if (info->assigned_obj->interrupts.count <= 1)
 		return;
 
 	/* IRQs with a load of 1 have most likely not had any interrupts and
@@ -75,18 +78,30 @@ static void move_candidate_irqs(struct irq_info *info, void *data)
 		return;
 
 	/*ǨжҪ֤жϸزܳڸСزֵһ */
-	if ((lb_info->adjustment_load - info->load) > (lb_info->min_load + info->load)) {
-		lb_info->adjustment_load -= info->load;
-		lb_info->min_load += info->load;
-	} else
+	if ((lb_info->adjustment_load - info->load) <= (lb_info->min_load + info->load))
 		return;
 
+	/*ǨƹжȴڲǨƣжCPU֮*/
+	if (irq_cooling_down(info)) {
+		migration_stats.cooling++;
+		return;
+	}
+
+	/*ǨʹزСжϸأҪǨƱĴ*/
+	if (!migration_profitable(2 * info->load, 1)) {
+		migration_stats.unprofitable++;
+		return;
+	}
+
+	lb_info->adjustment_load -= info->load;
+	lb_info->min_load += info->load;
+
 	log(TO_CONSOLE, LOG_INFO, "Selecting irq %d for rebalancing\n", info->irq);
 
 	/*жϴԭжɾrebalance_irq_list*/
 	migrate_irq(&info->assigned_obj->interrupts, &rebalance_irq_list, info);
 
-	info->assigned_obj = NULL;
+	set_irq_obj(info, NULL);
 }
 
 /*жϸĸعأжǨƣֱزҪжǨ*/
@@ -110,13 +125,13 @@ static void migrate_overloaded_irqs(struct topo_obj *obj, void *data)
 	}
 
 	if ((obj->load > info->min_load) &&
-	    (g_list_length(obj->interrupts) > 1)) {
+	    (obj->interrupts.count > 1)) {
 		/* жոشС */
 		sort_irq_list(&obj->interrupts);
 
 		/*жжϴƳֱĸѾ޷ǨƵ */
 		info->adjustment_load = obj->load;
-		for_each_irq(obj->interrupts, move_candidate_irqs, info);
+		for_each_irq(&obj->interrupts, move_candidate_irqs, info);
 	}
 }
 
@@ -124,7 +139,7 @@ static void migrate_overloaded_irqs(struct topo_obj *obj, void *data)
 static void force_irq_migration(struct irq_info *info, void *data __attribute__((unused)))
 {
 	migrate_irq(&info->assigned_obj->interrupts, &rebalance_irq_list, info);
-	info->assigned_obj = NULL;
+	set_irq_obj(info, NULL);
 }
 
 /*ȡһĽģʽ*/
@@ -153,17 +168,33 @@ static void find_overloaded_objs(GList *name, struct load_balance_info *info)
 	for_each_object(name, migrate_overloaded_irqs, info);
 }
 
+/* cpu level load statistics of the last update_migration_status() */
+static uint64_t cpu_avg_load = 0;
+static uint64_t cpu_max_load = 0;
+static long double cpu_std_deviation = 0;
+
+/*ȡһǨʱCPUƽءغ͸ر׼*/
+void get_cpu_load_spread(uint64_t *avg, uint64_t *max, long double *std_deviation)
+{
+	*avg = cpu_avg_load;
+	*max = cpu_max_load;
+	*std_deviation = cpu_std_deviation;
+}
+
 /*ӵײCPUʼиصǨƣεcachepackage򣬽ڵ򣬸CPU˽ṹжϸؾ״̬*/
 void update_migration_status(void)
 {
 	struct load_balance_info info;
 	find_overloaded_objs(cpus, &info);
+	cpu_avg_load = info.avg_load;
+	cpu_max_load = info.max_load;
+	cpu_std_deviation = info.std_deviation;
 	if (power_thresh != ULONG_MAX && cycle_count > 5) {
 		if (!info.num_over && (info.num_under >= power_thresh) && info.powersave) {
 			log(TO_ALL, LOG_INFO, "cpu %d entering powersave mode\n", info.powersave->number);
 			info.powersave->powersave_mode = 1;
-			if (g_list_length(info.powersave->interrupts) > 0)
-				for_each_irq(info.powersave->interrupts, force_irq_migration, NULL);
+			if (info.powersave->interrupts.count > 0)
+				for_each_irq(&info.powersave->interrupts, force_irq_migration, NULL);
 		} else if ((info.num_over) && (info.num_powersave)) {
 			log(TO_ALL, LOG_INFO, "Load average increasing, re-enabling all cpus for irq balancing\n");
 			for_each_object(cpus, clear_powersave_mode, NULL);
@@ -176,8 +207,10 @@ void update_migration_status(void)
 
 static void dump_workload(struct irq_info *info, void *unused __attribute__((unused)))
 {
-	log(TO_CONSOLE, LOG_INFO, "Interrupt %i node_num %d (class %s) has workload %lu \n",
-	    info->irq, irq_numa_node(info)->number, classes[info->class], (unsigned long)info->load);
+	log(TO_CONSOLE, LOG_INFO, "Interrupt %i node_num %d (class %s) has workload %lu (+-%.0f ns/s), "
+	    "%.0f irqs/s at %.0f ns, moved %u times\n",
+	    info->irq, irq_numa_node(info)->number, classes[info->class], (unsigned long)info->load,
+	    sqrt(info->load_avg.var), info->rate.mean, info->ns_per_irq, info->nr_moves);
 }
 
 void dump_workloads(void)
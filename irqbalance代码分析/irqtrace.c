@@ -0,0 +1,485 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "irqbalance.h"
+
+#define TRACE_INSTANCE "instances/irqbalance"
+#define TRACE_BUF_LEN 65536
+#define TRACE_POLL_MS 500
+/* let events pile up between reads instead of waking for each one */
+#define TRACE_BATCH_NS 10000000
+
+/*
+ * Optional load measurement from the irq tracepoints.  A consumer thread
+ * reads the trace_pipe of a private tracefs instance and sums, under
+ * trace_lock, the nanoseconds spent in each irq handler and in softirqs
+ * on each cpu.  Once per cycle the main thread moves those sums into the
+ * snapshot arrays, which only it reads.
+ */
+int irq_trace_active = 0;
+
+static const char *tracefs_roots[] = {
+	"/sys/kernel/tracing",
+	"/sys/kernel/debug/tracing",
+	NULL
+};
+
+static const char *trace_events[] = {
+	"irq/irq_handler_entry",
+	"irq/irq_handler_exit",
+	"irq/softirq_entry",
+	"irq/softirq_exit",
+	NULL
+};
+
+static char trace_dir[PATH_MAX];
+static int trace_fd = -1;
+static pthread_t trace_thread;
+static volatile int trace_stop = 0;
+
+/* per-cpu handler state, only touched by the consumer thread */
+struct cpu_trace_state {
+	int irq;		/* irq whose handler is running, -1 if none */
+	uint64_t irq_ts;
+	int in_softirq;
+	int vec;
+	uint64_t softirq_ts;
+	uint64_t nested_ns;	/* hardirq time inside the running softirq */
+};
+
+static struct cpu_trace_state *cpu_state = NULL;
+static int cpu_state_size = 0;
+
+/* accumulated since the last snapshot, protected by trace_lock */
+struct trace_sums {
+	uint64_t *irq_ns;
+	int irq_size;
+	uint64_t *hardirq_ns;
+	uint64_t *softirq_ns;	/* NR_SOFTIRQ_VECS per cpu */
+	int cpu_size;
+	uint64_t events;
+	uint64_t consumer_ns;
+};
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_sums live;
+static struct trace_sums snap;
+
+/*ѼneededԪأ0*/
+static int grow_ns_array(uint64_t **array, int size, int needed)
+{
+	uint64_t *new_array;
+
+	new_array = realloc(*array, needed * sizeof(uint64_t));
+	if (!new_array)
+		return -1;
+	memset(new_array + size, 0, (needed - size) * sizeof(uint64_t));
+	*array = new_array;
+	return 0;
+}
+
+/*2ݴμneededԪصС*/
+static int round_size(int size, int needed)
+{
+	size = size ? size : 64;
+	while (size < needed)
+		size <<= 1;
+	return size;
+}
+
+/*жϺۼ*/
+static int grow_irq_sums(struct trace_sums *s, int irq)
+{
+	int size;
+
+	if (irq < s->irq_size)
+		return 0;
+	size = round_size(s->irq_size, irq + 1);
+	if (grow_ns_array(&s->irq_ns, s->irq_size, size))
+		return -1;
+	s->irq_size = size;
+	return 0;
+}
+
+/*CPUۼ*/
+static int grow_cpu_sums(struct trace_sums *s, int cpu)
+{
+	int size;
+
+	if (cpu < s->cpu_size)
+		return 0;
+	size = round_size(s->cpu_size, cpu + 1);
+	if (grow_ns_array(&s->hardirq_ns, s->cpu_size, size) ||
+	    grow_ns_array(&s->softirq_ns, s->cpu_size * NR_SOFTIRQ_VECS,
+			  size * NR_SOFTIRQ_VECS))
+		return -1;
+	s->cpu_size = size;
+	return 0;
+}
+
+/*ȡCPU߳е״̬Ҫʱ״̬*/
+static struct cpu_trace_state *get_cpu_state(int cpu)
+{
+	struct cpu_trace_state *new_state;
+	int i, size;
+
+	if (cpu >= cpu_state_size) {
+		size = round_size(cpu_state_size, cpu + 1);
+		new_state = realloc(cpu_state, size * sizeof(struct cpu_trace_state));
+		if (!new_state)
+			return NULL;
+		for (i = cpu_state_size; i < size; i++) {
+			memset(&new_state[i], 0, sizeof(struct cpu_trace_state));
+			new_state[i].irq = -1;
+		}
+		cpu_state = new_state;
+		cpu_state_size = size;
+	}
+	return &cpu_state[cpu];
+}
+
+/*".С"ʽʱת*/
+static uint64_t parse_trace_ts(const char *p)
+{
+	uint64_t sec, frac = 0;
+	int digits = 0;
+
+	sec = strtoull(p, (char **)&p, 10);
+	if (*p == '.') {
+		p++;
+		while (isdigit(*p) && digits < 9) {
+			frac = frac * 10 + (*p - '0');
+			digits++;
+			p++;
+		}
+	}
+	while (digits++ < 9)
+		frac *= 10;
+	return sec * 1000000000ULL + frac;
+}
+
+/*
+ * Handle one trace_pipe line such as
+ *   <idle>-0  [002] d.h1.  4136.123456: irq_handler_entry: irq=30 name=eth0
+ * The caller holds trace_lock.
+ */
+static void handle_trace_line(char *line)
+{
+	struct cpu_trace_state *st;
+	char *p, *event;
+	uint64_t ts, delta;
+	int cpu, irq;
+
+	/*ʧ¼ʱ޷ԣCPUδɵļ¼*/
+	if (!strncmp(line, "CPU:", 4) && strstr(line, "LOST")) {
+		for (cpu = 0; cpu < cpu_state_size; cpu++) {
+			cpu_state[cpu].irq = -1;
+			cpu_state[cpu].in_softirq = 0;
+		}
+		return;
+	}
+
+	p = strchr(line, '[');
+	if (!p || !isdigit(p[1]))
+		return;
+	cpu = strtoul(p + 1, &p, 10);
+	if (*p != ']')
+		return;
+
+	/*ʱ"]"֮һ": "βֶ*/
+	event = strstr(p, ": ");
+	if (!event)
+		return;
+	*event = '\0';
+	event += 2;
+	p = strrchr(p, ' ');
+	if (!p)
+		return;
+	ts = parse_trace_ts(p + 1);
+
+	st = get_cpu_state(cpu);
+	if (!st || grow_cpu_sums(&live, cpu))
+		return;
+	live.events++;
+
+	if (!strncmp(event, "irq_handler_entry:", 18)) {
+		p = strstr(event, "irq=");
+		if (!p)
+			return;
+		st->irq = strtoul(p + 4, NULL, 10);
+		st->irq_ts = ts;
+	} else if (!strncmp(event, "irq_handler_exit:", 17)) {
+		p = strstr(event, "irq=");
+		if (!p)
+			return;
+		irq = strtoul(p + 4, NULL, 10);
+		if (irq != st->irq || ts < st->irq_ts) {
+			st->irq = -1;
+			return;
+		}
+		delta = ts - st->irq_ts;
+		st->irq = -1;
+		if (!grow_irq_sums(&live, irq))
+			live.irq_ns[irq] += delta;
+		live.hardirq_ns[cpu] += delta;
+		if (st->in_softirq)
+			st->nested_ns += delta;
+	} else if (!strncmp(event, "softirq_entry:", 14)) {
+		p = strstr(event, "vec=");
+		if (!p)
+			return;
+		st->vec = strtoul(p + 4, NULL, 10);
+		if (st->vec >= NR_SOFTIRQ_VECS)
+			return;
+		st->in_softirq = 1;
+		st->softirq_ts = ts;
+		st->nested_ns = 0;
+	} else if (!strncmp(event, "softirq_exit:", 13)) {
+		if (!st->in_softirq || ts < st->softirq_ts)
+			return;
+		st->in_softirq = 0;
+		delta = ts - st->softirq_ts;
+		/*жڼ䱻ӲжϴϵʱѾӲж*/
+		if (delta > st->nested_ns)
+			live.softirq_ns[cpu * NR_SOFTIRQ_VECS + st->vec] += delta - st->nested_ns;
+	}
+}
+
+/*ȡǰ߳ռõCPUʱ*/
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*̣߳϶ȡtrace_pipeۼжϴʱ*/
+static void *irq_trace_consumer(void *arg __attribute__((unused)))
+{
+	struct pollfd pfd = { .fd = trace_fd, .events = POLLIN };
+	struct timespec batch = { 0, TRACE_BATCH_NS };
+	char *buf, *line, *nl;
+	size_t len = 0;
+	ssize_t rc;
+	uint64_t start;
+
+	buf = malloc(TRACE_BUF_LEN);
+	if (!buf)
+		return NULL;
+
+	while (!trace_stop) {
+		if (poll(&pfd, 1, TRACE_POLL_MS) <= 0)
+			continue;
+		rc = read(trace_fd, buf + len, TRACE_BUF_LEN - len - 1);
+		if (rc <= 0)
+			continue;
+		start = thread_cpu_ns();
+		len += rc;
+		buf[len] = '\0';
+
+		pthread_mutex_lock(&trace_lock);
+		line = buf;
+		while ((nl = strchr(line, '\n'))) {
+			*nl = '\0';
+			handle_trace_line(line);
+			line = nl + 1;
+		}
+		live.consumer_ns += thread_cpu_ns() - start;
+		pthread_mutex_unlock(&trace_lock);
+
+		/*һ´ζȡʱֱӶ*/
+		len -= line - buf;
+		if (len >= TRACE_BUF_LEN - 1)
+			len = 0;
+		memmove(buf, line, len);
+
+		/*ûж˵¼Ѿȡ꣬ȴһʱٳȡ*/
+		if (rc < TRACE_BUF_LEN / 2)
+			nanosleep(&batch, NULL);
+	}
+	free(buf);
+	return NULL;
+}
+
+/*traceʵĿ¼µļдַ*/
+static int write_trace_file(const char *file, const char *val)
+{
+	char path[PATH_MAX];
+	ssize_t rc;
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s", trace_dir, file) >= (int)sizeof(path))
+		return -1;
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	rc = write(fd, val, strlen(val));
+	close(fd);
+	return rc < 0 ? -1 : 0;
+}
+
+/*򿪻رҪжϸ¼*/
+static int enable_trace_events(const char *val)
+{
+	char file[PATH_MAX];
+	int i, rc = 0;
+
+	for (i = 0; trace_events[i]; i++) {
+		snprintf(file, PATH_MAX, "events/%s/enable", trace_events[i]);
+		if (write_trace_file(file, val))
+			rc = -1;
+	}
+	return rc;
+}
+
+/*رո¼ɾtraceʵ*/
+static void remove_trace_instance(void)
+{
+	enable_trace_events("0");
+	rmdir(trace_dir);
+}
+
+/*
+ * Create our tracefs instance, enable the irq tracepoints in it and start
+ * the consumer thread.  Must be called after daemonizing.  On failure
+ * balancing keeps using the jiffies based load from /proc/stat.
+ */
+int init_irq_trace(void)
+{
+	char path[PATH_MAX];
+	int i;
+
+	for (i = 0; tracefs_roots[i]; i++) {
+		snprintf(path, PATH_MAX, "%s/instances", tracefs_roots[i]);
+		if (!access(path, W_OK))
+			break;
+	}
+	if (!tracefs_roots[i]) {
+		log(TO_ALL, LOG_WARNING, "tracefs is not available, using /proc/stat for irq load\n");
+		return -1;
+	}
+
+	snprintf(trace_dir, PATH_MAX, "%s/%s", tracefs_roots[i], TRACE_INSTANCE);
+	if (mkdir(trace_dir, 0700) && errno != EEXIST)
+		goto out_fail;
+	if (enable_trace_events("1") || write_trace_file("tracing_on", "1"))
+		goto out_remove;
+
+	if (snprintf(path, sizeof(path), "%s/trace_pipe", trace_dir) >= (int)sizeof(path))
+		goto out_remove;
+	trace_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (trace_fd < 0)
+		goto out_remove;
+
+	trace_stop = 0;
+	if (pthread_create(&trace_thread, NULL, irq_trace_consumer, NULL))
+		goto out_close;
+
+	irq_trace_active = 1;
+	log(TO_CONSOLE, LOG_INFO, "Measuring irq load from tracepoints in %s\n", trace_dir);
+	return 0;
+
+out_close:
+	close(trace_fd);
+	trace_fd = -1;
+out_remove:
+	remove_trace_instance();
+out_fail:
+	log(TO_ALL, LOG_WARNING, "Unable to set up irq tracing in %s, using /proc/stat for irq load\n",
+	    trace_dir);
+	return -1;
+}
+
+/*ֹ̣ͣ߳ɾtraceʵͷۼ*/
+void stop_irq_trace(void)
+{
+	if (!irq_trace_active)
+		return;
+
+	trace_stop = 1;
+	pthread_join(trace_thread, NULL);
+	close(trace_fd);
+	trace_fd = -1;
+	remove_trace_instance();
+	irq_trace_active = 0;
+
+	free(live.irq_ns);
+	free(live.hardirq_ns);
+	free(live.softirq_ns);
+	free(snap.irq_ns);
+	free(snap.hardirq_ns);
+	free(snap.softirq_ns);
+	memset(&live, 0, sizeof(live));
+	memset(&snap, 0, sizeof(snap));
+	free(cpu_state);
+	cpu_state = NULL;
+	cpu_state_size = 0;
+}
+
+/*
+ * Move everything the consumer accumulated since the last call into the
+ * snapshot read by the irq_trace_*_ns() accessors, once per cycle
+ */
+void irq_trace_snapshot(void)
+{
+	if (!irq_trace_active)
+		return;
+
+	pthread_mutex_lock(&trace_lock);
+	if (grow_irq_sums(&snap, live.irq_size - 1) ||
+	    grow_cpu_sums(&snap, live.cpu_size - 1)) {
+		pthread_mutex_unlock(&trace_lock);
+		return;
+	}
+	memset(snap.irq_ns, 0, snap.irq_size * sizeof(uint64_t));
+	memset(snap.hardirq_ns, 0, snap.cpu_size * sizeof(uint64_t));
+	memset(snap.softirq_ns, 0, snap.cpu_size * NR_SOFTIRQ_VECS * sizeof(uint64_t));
+	memcpy(snap.irq_ns, live.irq_ns, live.irq_size * sizeof(uint64_t));
+	memcpy(snap.hardirq_ns, live.hardirq_ns, live.cpu_size * sizeof(uint64_t));
+	memcpy(snap.softirq_ns, live.softirq_ns,
+	       live.cpu_size * NR_SOFTIRQ_VECS * sizeof(uint64_t));
+	memset(live.irq_ns, 0, live.irq_size * sizeof(uint64_t));
+	memset(live.hardirq_ns, 0, live.cpu_size * sizeof(uint64_t));
+	memset(live.softirq_ns, 0, live.cpu_size * NR_SOFTIRQ_VECS * sizeof(uint64_t));
+	snap.events = live.events;
+	snap.consumer_ns = live.consumer_ns;
+	live.events = 0;
+	live.consumer_ns = 0;
+	pthread_mutex_unlock(&trace_lock);
+
+	log(TO_CONSOLE, LOG_INFO, "Traced %llu irq events, consumer used %llu us (%llu us per million events)\n",
+	    (unsigned long long)snap.events, (unsigned long long)snap.consumer_ns / 1000,
+	    snap.events ? (unsigned long long)(snap.consumer_ns / snap.events) * 1000 : 0ULL);
+}
+
+/*һжϴռõ*/
+uint64_t irq_trace_irq_ns(int irq)
+{
+	return (irq >= 0 && irq < snap.irq_size) ? snap.irq_ns[irq] : 0;
+}
+
+/*һCPUӲжϵ*/
+uint64_t irq_trace_hardirq_ns(int cpu)
+{
+	return (cpu >= 0 && cpu < snap.cpu_size) ? snap.hardirq_ns[cpu] : 0;
+}
+
+/*һCPUĳһжϵ*/
+uint64_t irq_trace_softirq_ns(int cpu, int vec)
+{
+	return (cpu >= 0 && cpu < snap.cpu_size) ?
+		snap.softirq_ns[cpu * NR_SOFTIRQ_VECS + vec] : 0;
+}
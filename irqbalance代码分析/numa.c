@@ -11,12 +11,17 @@
 
 GList *numa_nodes = NULL;
 
+/* Lookup array for numa_nodes, indexed by node id */
+static struct topo_index numa_node_index;
+
+/* Memory the node objects are allocated from */
+static struct obj_pool numa_node_pool = OBJ_POOL_INIT(struct topo_obj);
+
 static struct topo_obj unspecified_node_template = {
 	.load = 0,
 	.number = -1,
 	.obj_type = OBJ_TYPE_NODE,
 	.mask = CPU_MASK_ALL,
-	.interrupts = NULL,
 	.children = NULL,
 	.parent = NULL,
 	.obj_type_list = &numa_nodes,
@@ -24,6 +29,62 @@ static struct topo_obj unspecified_node_template = {
 
 static struct topo_obj unspecified_node;
 
+/*
+ * Rows of /sys/devices/system/node/nodeN/distance, indexed by node id,
+ * for the placement cost of moving an irq away from its device's node
+ */
+struct node_distance {
+	int *dist;
+	int nr;
+	int size;
+};
+
+static struct node_distance *node_distances = NULL;
+static int node_distances_size = 0;
+
+/*ȡһڵ㵽ڵľ*/
+static void read_node_distance(int nodeid, const char *nodename)
+{
+	struct node_distance *row;
+	char path[PATH_MAX];
+	char *line = NULL, *p, *end;
+	size_t size = 0;
+	long val;
+	FILE *f;
+
+	if (nodeid < 0 || grow_array((void **)&node_distances, &node_distances_size,
+				     nodeid + 1, sizeof(struct node_distance)))
+		return;
+	row = &node_distances[nodeid];
+	row->nr = 0;
+
+	sprintf(path, "%s/%s/distance", SYSFS_NODE_PATH, nodename);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (getline(&line, &size, f) > 0) {
+		for (p = line; ; p = end) {
+			val = strtol(p, &end, 10);
+			if (end == p || grow_array((void **)&row->dist, &row->size,
+						   row->nr + 1, sizeof(int)))
+				break;
+			row->dist[row->nr++] = val;
+		}
+	}
+	free(line);
+	fclose(f);
+}
+
+/*ڵ֮ľ룬δ֪ʱں˵ȱʡֵ*/
+int numa_distance(int from, int to)
+{
+	if (from < 0 || to < 0 || from == to)
+		return LOCAL_DISTANCE;
+	if (from < node_distances_size && to < node_distances[from].nr)
+		return node_distances[from].dist[to];
+	return REMOTE_DISTANCE;
+}
+
 /*һһڴʽڵṹ*/
 static void add_one_node(const char *nodename)
 {
@@ -34,14 +95,14 @@ static void add_one_node(const char *nodename)
 	ssize_t ret;
 	size_t blen;
 
-	new = calloc(1, sizeof(struct topo_obj));
+	new = obj_pool_alloc(&numa_node_pool);
 	if (!new)
 		return;
 	/*ڵӦпеCPU*/
 	sprintf(path, "%s/%s/cpumap", SYSFS_NODE_PATH, nodename);
 	f = fopen(path, "r");
 	if (!f) {
-		free(new);
+		obj_pool_free(&numa_node_pool, new);
 		return;
 	}
 	if (ferror(f)) {
@@ -60,9 +121,11 @@ static void add_one_node(const char *nodename)
 	/*ڵϢ*/
 	new->obj_type = OBJ_TYPE_NODE;	
 	new->number = strtoul(&nodename[4], NULL, 10);
+	read_node_distance(new->number, nodename);
 	new->obj_type_list = &numa_nodes;
 	/*½Ľڵڵ*/
 	numa_nodes = g_list_append(numa_nodes, new);
+	topo_index_set(&numa_node_index, new);
 }
 
 /*һNUMAϵͳ֧NUMAеNUMAڵ뵽*/
@@ -96,15 +159,11 @@ void build_numa_node_list(void)
 	closedir(dir);
 }
 
-/*ͷNUMAڵռ䣬ռԼжռ*/
+/*ͷNUMAڵڵڴһͷ*/
 static void free_numa_node(gpointer data)
 {
 	struct topo_obj *obj = data;
 	g_list_free(obj->children);
-	g_list_free(obj->interrupts);
-
-	if (data != &unspecified_node)
-		free(data);
 }
 
 /*ͷڵԼϵĽڵռ*/
@@ -112,23 +171,23 @@ void free_numa_node_list(void)
 {
 	g_list_free_full(numa_nodes, free_numa_node);
 	numa_nodes = NULL;
-}
-
-/*ȽڵǷһ£򷵻0*/
-static gint compare_node(gconstpointer a, gconstpointer b)
-{
-	const struct topo_obj *ai = a;
-	const struct topo_obj *bi = b;
-
-	return (ai->number == bi->number) ? 0 : 1;
+	topo_index_clear(&numa_node_index);
+	obj_pool_reset(&numa_node_pool);
 }
 
 /*packageָڵ*/
 void add_package_to_node(struct topo_obj *p, int nodeid)
 {
 	struct topo_obj *node;
-	/*ݽڵҵָNUMAڵ*/
+	/*ݽڵҵָNUMAڵ㣬CPUʱܴµĽڵ㣬ʱ佨ýڵ*/
 	node = get_numa_node(nodeid);
+	if (!node && nodeid >= 0) {
+		char nodename[32];
+
+		snprintf(nodename, sizeof(nodename), "node%d", nodeid);
+		add_one_node(nodename);
+		node = get_numa_node(nodeid);
+	}
 
 	if (!node) {
 		log(TO_CONSOLE, LOG_INFO, "Could not find numa node for node id %d\n", nodeid);
@@ -154,18 +213,12 @@ void dump_numa_node_info(struct topo_obj *d, void *unused __attribute__((unused)
 /*ݽڵIDҵӦNMUAڵ*/
 struct topo_obj *get_numa_node(int nodeid)
 {
-	struct topo_obj find;
-	GList *entry;
-
 	if (!numa_avail)
 		return &unspecified_node;
 
 	if (nodeid == -1)
 		return &unspecified_node;
 
-	find.number = nodeid;
-
-	entry = g_list_find_custom(numa_nodes, &find, compare_node);
-	return entry ? entry->data : NULL;
+	return topo_index_get(&numa_node_index, nodeid);
 }
 
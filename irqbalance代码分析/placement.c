@@ -8,64 +8,337 @@
 #include "irqbalance.h"
 
 
-GList *rebalance_irq_list;
+struct irq_list rebalance_irq_list;
 
 /*ǨĿݽṹ*/
 struct obj_placement {
-		struct topo_obj *best;	//ٵ
-		struct topo_obj *least_irqs;	//ٲжĿҲٵ
-		uint64_t best_cost;	 //ٵĸֵ
+		struct topo_obj *best;	//Сһʱ١жĿٵ
+		uint64_t best_cost;
 		struct irq_info *info;
 };
 
-/*жdǷʺΪǨжϵĿѡ*/
-static void find_best_object(struct topo_obj *d, void *data)
+/*
+ * Candidate children of the object whose irqs are being placed, kept as
+ * a min-heap on load, then number of irqs, then position among the
+ * children.  The top is the child find_best_object() picks for an irq
+ * without an affinity subset, and only the child that got the irq has to
+ * be moved, so placing an irq is O(log n) instead of a walk over all of
+ * them.  Among equally loaded children this takes the one with the
+ * fewest irqs.  The scan it replaced took the last one with fewer irqs
+ * than the first, which differs when several have fewer.
+ */
+struct heap_entry {
+	struct topo_obj *obj;
+	int pos;
+};
+
+struct obj_heap {
+	struct heap_entry *ents;
+	int nr;
+	int size;
+};
+
+static struct obj_heap place_heap;
+
+/*
+ * Slots of place_heap still to be looked at by the best first search in
+ * pick_best_object(), as a min-heap of their own ordered like the slots
+ */
+struct slot_heap {
+	int *slots;
+	int nr;
+	int size;
+};
+
+static struct slot_heap frontier;
+
+static int heap_entry_less(const struct heap_entry *a, const struct heap_entry *b)
 {
-	struct obj_placement *best = (struct obj_placement *)data;
-	uint64_t newload;
-	cpumask_t subset;
+	if (a->obj->load != b->obj->load)
+		return a->obj->load < b->obj->load;
+	if (a->obj->interrupts.count != b->obj->interrupts.count)
+		return a->obj->interrupts.count < b->obj->interrupts.count;
+	return a->pos < b->pos;
+}
+
+static void heap_set(struct obj_heap *heap, int i, struct heap_entry ent)
+{
+	heap->ents[i] = ent;
+	ent.obj->heap_pos = i;
+}
+
+static void heap_sift_up(struct obj_heap *heap, int i)
+{
+	struct heap_entry ent = heap->ents[i];
+
+	while (i > 0 && heap_entry_less(&ent, &heap->ents[(i - 1) / 2])) {
+		heap_set(heap, i, heap->ents[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	heap_set(heap, i, ent);
+}
+
+static void heap_sift_down(struct obj_heap *heap, int i)
+{
+	struct heap_entry ent = heap->ents[i];
+	int child;
+
+	while ((child = 2 * i + 1) < heap->nr) {
+		if (child + 1 < heap->nr &&
+		    heap_entry_less(&heap->ents[child + 1], &heap->ents[child]))
+			child++;
+		if (!heap_entry_less(&heap->ents[child], &ent))
+			break;
+		heap_set(heap, i, heap->ents[child]);
+		i = child;
+	}
+	heap_set(heap, i, ent);
+}
+
+/*ĸػжĿ仯ڶеλãڶе*/
+static void heap_update(struct obj_heap *heap, struct topo_obj *d)
+{
+	int i = d->heap_pos;
+
+	if (i < 0 || i >= heap->nr || heap->ents[i].obj != d)
+		return;
+	heap_sift_up(heap, i);
+	heap_sift_down(heap, d->heap_pos);
+}
+
+/*frontierеĵiλϵ*/
+static void frontier_sift_up(int i)
+{
+	int slot = frontier.slots[i];
+
+	while (i > 0 && heap_entry_less(&place_heap.ents[slot],
+					&place_heap.ents[frontier.slots[(i - 1) / 2]])) {
+		frontier.slots[i] = frontier.slots[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	frontier.slots[i] = slot;
+}
+
+static int frontier_push(int slot)
+{
+	if (slot >= place_heap.nr)
+		return 0;
+	if (grow_array((void **)&frontier.slots, &frontier.size, frontier.nr + 1, sizeof(int)))
+		return -1;
+	frontier.slots[frontier.nr] = slot;
+	frontier_sift_up(frontier.nr++);
+	return 0;
+}
+
+static int frontier_pop(void)
+{
+	int top = frontier.slots[0], slot, i = 0, child;
+
+	slot = frontier.slots[--frontier.nr];
+	while ((child = 2 * i + 1) < frontier.nr) {
+		if (child + 1 < frontier.nr &&
+		    heap_entry_less(&place_heap.ents[frontier.slots[child + 1]],
+				    &place_heap.ents[frontier.slots[child]]))
+			child++;
+		if (!heap_entry_less(&place_heap.ents[frontier.slots[child]], &place_heap.ents[slot]))
+			break;
+		frontier.slots[i] = frontier.slots[child];
+		i = child;
+	}
+	if (frontier.nr)
+		frontier.slots[i] = slot;
+	return top;
+}
+
+/*dtypeȣdǸʱd*/
+static struct topo_obj *obj_ancestor(struct topo_obj *d, enum obj_type_e type)
+{
+	while (d && d->obj_type != type)
+		d = d->parent;
+	return d;
+}
+
+/*ͬһ豸msiѾcachedµĿ*/
+static unsigned int device_vectors_in(struct irq_info *info, struct topo_obj *d)
+{
+	struct irq_info *v;
+	unsigned int count = 0;
+
+	for (v = info->dev_next; v && v != info; v = v->dev_next)
+		if (obj_ancestor(v->assigned_obj, OBJ_TYPE_CACHE) == d)
+			count++;
+	return count;
+}
+
+/*
+ * The default cost of placing info in d: the load d already carries,
+ * plus penalties for a numa node far from the device, for leaving the
+ * package the irq was last placed in, for piling irqs of one class on a
+ * cache domain or cpu, and for msi vectors of one device sharing a cache
+ * domain.
+ *
+ * Keep every term non-negative.  pick_best_object() stops walking the
+ * heap once a child's load alone reaches the best cost found, so a bonus
+ * that took a cost below its load could leave that child unseen, and
+ * the solver takes the load back off the cost as an unsigned value.
+ */
+static uint64_t penalty_cost(struct topo_obj *d, struct irq_info *info)
+{
+	uint64_t cost = d->load;
+	struct topo_obj *node;
+	int dist;
+
+	node = obj_ancestor(d, OBJ_TYPE_NODE);
+	if (node && node->number >= 0 && irq_numa_node(info)->number >= 0) {
+		dist = numa_distance(irq_numa_node(info)->number, node->number);
+		if (dist > LOCAL_DISTANCE)
+			cost += scale_penalty((uint64_t)NUMA_PENALTY * (dist - LOCAL_DISTANCE));
+	}
+
+	switch (d->obj_type) {
+	case OBJ_TYPE_PACKAGE:
+		if (info->home_package >= 0 && d->number != info->home_package)
+			cost += scale_penalty(CROSS_PACKAGE_PENALTY);
+		break;
+	case OBJ_TYPE_CACHE:
+		if (info->class != IRQ_OTHER)
+			cost += scale_penalty((uint64_t)CLASS_VIOLATION_PENTALTY * d->class_count[info->class]);
+		if (info->type == IRQ_TYPE_MSI || info->type == IRQ_TYPE_MSIX)
+			cost += scale_penalty((uint64_t)MSI_CACHE_PENALTY * device_vectors_in(info, d));
+		break;
+	case OBJ_TYPE_CPU:
+		if (info->class != IRQ_OTHER)
+			cost += scale_penalty((uint64_t)CLASS_VIOLATION_PENTALTY * d->class_count[info->class] / 2);
+		break;
+	default:
+		break;
+	}
+	return cost;
+}
+
+/*жʱʹõĴۺֵСĸ*/
+placement_cost_fn placement_cost = penalty_cost;
 
+/*ھжϵļ飺dܷΪǨжϵĿ*/
+static int object_usable(struct topo_obj *d)
+{
 	/*õNUMAͷ */
 	if (numa_avail && (d->obj_type == OBJ_TYPE_NODE) && (d->number == -1))
-		return;
+		return 0;
 
 	/*޿CPUNUMAڵ */
 	if ((d->obj_type == OBJ_TYPE_NODE) &&
 	    (!cpus_intersects(d->mask, unbanned_cpus)))
-		return;
+		return 0;
 
-	/*֤жϵ׺ͶҪ */
-	if (best->info->hint_policy == HINT_POLICY_SUBSET) {
-		if (!cpus_empty(best->info->affinity_hint)) {
-			cpus_and(subset, best->info->affinity_hint, d->mask);
-			if (cpus_empty(subset))
-				return;
-		}
+	if (d->powersave_mode)
+		return 0;
+	return 1;
+}
+
+/*listпõ*/
+static void heap_build(struct obj_heap *heap, GList *list)
+{
+	GList *entry;
+	struct heap_entry ent;
+	int i, pos = 0;
+
+	heap->nr = 0;
+	for (entry = g_list_first(list); entry; entry = g_list_next(entry), pos++) {
+		ent.obj = entry->data;
+		ent.pos = pos;
+		if (!object_usable(ent.obj))
+			continue;
+		if (grow_array((void **)&heap->ents, &heap->size, heap->nr + 1,
+			       sizeof(struct heap_entry)))
+			break;
+		heap_set(heap, heap->nr++, ent);
 	}
+	for (i = heap->nr / 2 - 1; i >= 0; i--)
+		heap_sift_down(heap, i);
+}
 
-	if (d->powersave_mode)
+/*жǷֻܷ׺Ͷʾн*/
+static inline int irq_has_subset_hint(struct irq_info *info)
+{
+	return info->hint_policy == HINT_POLICY_SUBSET &&
+	       !cpus_empty(info->affinity_hint);
+}
+
+/*жdǷʺΪǨжϵĿѡѡС򣬴һʱѡ١жĿٵ*/
+static void find_best_object(struct topo_obj *d, void *data)
+{
+	struct obj_placement *best = (struct obj_placement *)data;
+	cpumask_t subset;
+	uint64_t cost;
+
+	if (!object_usable(d))
 		return;
 
-	newload = d->load;
+	/*֤жϵ׺ͶҪ */
+	if (irq_has_subset_hint(best->info)) {
+		cpus_and(subset, best->info->affinity_hint, d->mask);
+		if (cpus_empty(subset))
+			return;
+	}
 
-	/*dиֵСڼ¼ֵΪ*/
-	if (newload < best->best_cost) {
+	cost = placement_cost(d, best->info);
+	if (!best->best || cost < best->best_cost ||
+	    (cost == best->best_cost &&
+	     (d->load < best->best->load ||
+	      (d->load == best->best->load &&
+	       d->interrupts.count < best->best->interrupts.count)))) {
 		best->best = d;
-		best->best_cost = newload;
-		best->least_irqs = NULL;
+		best->best_cost = cost;
+	}
+}
+
+/*listΪжҴСlistпõplace_heap*/
+static struct topo_obj *pick_best_object(GList *list, struct irq_info *info)
+{
+	struct obj_placement place;
+	struct topo_obj *d;
+	uint64_t cost;
+	int slot;
+
+	place.info = info;
+	place.best = NULL;
+	place.best_cost = 0;
+
+	/*׺ͶӼҪжϣѡж϶죬ֻ*/
+	if (irq_has_subset_hint(info)) {
+		for_each_object(list, find_best_object, &place);
+		return place.best;
 	}
 
-	/*gĸ¼ֵһжĿ٣*/
-	if (newload == best->best_cost) {
-		if (g_list_length(d->interrupts) < g_list_length(best->best->interrupts))
-			best->least_irqs = d;
+	/*
+	 * Walk the heap in load order from the top.  The cost is never below
+	 * the load, so once the next slot's load reaches the best cost found
+	 * nothing further down can beat it.  Without penalties that is the
+	 * top.
+	 */
+	frontier.nr = 0;
+	if (frontier_push(0))
+		return place_heap.nr ? place_heap.ents[0].obj : NULL;
+	while (frontier.nr) {
+		slot = frontier_pop();
+		d = place_heap.ents[slot].obj;
+		if (place.best && d->load >= place.best_cost)
+			break;
+		cost = placement_cost(d, info);
+		if (!place.best || cost < place.best_cost) {
+			place.best = d;
+			place.best_cost = cost;
+		}
+		if (frontier_push(2 * slot + 1) || frontier_push(2 * slot + 2))
+			break;
 	}
+	return place.best;
 }
 
 /*ΪҪǨĿж*/
 static void find_best_object_for_irq(struct irq_info *info, void *data)
 {
-	struct obj_placement place;
 	struct topo_obj *d = data;
 	struct topo_obj *asign;
 
@@ -94,37 +367,30 @@ static void find_best_object_for_irq(struct irq_info *info, void *data)
 		break;
 	}
 
-	/*ȳʼѡݽṹ*/
-	place.info = info;
-	place.best = NULL;
-	place.least_irqs = NULL;
-	place.best_cost = ULLONG_MAX;
-
-	/*ڵҵŵϢ浽ѡݽṹ*/
-	for_each_object(d->children, find_best_object, &place);
-
-	/*иٲжĿҲٵģΪǨĿ꣬ѡٵΪǨĿ*/
-	asign = place.least_irqs ? place.least_irqs : place.best;
+	/*dҵŵ*/
+	asign = pick_best_object(d->children, info);
 
-	/*жǨƵĿϣĸ*/
+	/*жǨƵĿϣĸؼڶеλ*/
 	if (asign) {
 		migrate_irq(&d->interrupts, &asign->interrupts, info);
-		info->assigned_obj = asign;
+		set_irq_obj(info, asign);
 		asign->load += info->load;
+		heap_update(&place_heap, asign);
 	}
 }
 
 /*Ϊdжҵʵ*/
 static void place_irq_in_object(struct topo_obj *d, void *data __attribute__((unused)))
 {
-	if (g_list_length(d->interrupts) > 0)
-		for_each_irq(d->interrupts, find_best_object_for_irq, d);
+	if (d->interrupts.count > 0) {
+		heap_build(&place_heap, d->children);
+		for_each_irq(&d->interrupts, find_best_object_for_irq, d);
+	}
 }
 
 /*жϲʵ*/
 static void place_irq_in_node(struct irq_info *info, void *data __attribute__((unused)))
 {
-	struct obj_placement place;
 	struct topo_obj *asign;
 
 	if ((info->level == BALANCE_NONE) && cpus_empty(banned_cpus))
@@ -136,30 +402,279 @@ static void place_irq_in_node(struct irq_info *info, void *data __attribute__((u
 		if (!cpus_intersects(irq_numa_node(info)->mask, unbanned_cpus))
 			goto find_placement;
 
-		migrate_irq(&rebalance_irq_list, &irq_numa_node(info)->interrupts, info);
-		info->assigned_obj = irq_numa_node(info);
-		irq_numa_node(info)->load += info->load + 1;
+		asign = irq_numa_node(info);
+		migrate_irq(&rebalance_irq_list, &asign->interrupts, info);
+		set_irq_obj(info, asign);
+		asign->load += info->load + 1;
+		heap_update(&place_heap, asign);
 		return;
 	}
 	
-/*ͨݽṹԼķʽѰŵ*/
+/*нڵѰŵ*/
 find_placement:
-	place.best_cost = ULLONG_MAX;
-	place.best = NULL;
-	place.least_irqs = NULL;
-	place.info = info;
-
-	for_each_object(numa_nodes, find_best_object, &place);
-
-	asign = place.least_irqs ? place.least_irqs : place.best;
+	asign = pick_best_object(numa_nodes, info);
 
 	if (asign) {
 		migrate_irq(&rebalance_irq_list, &asign->interrupts, info);
-		info->assigned_obj = asign;
+		set_irq_obj(info, asign);
 		asign->load += info->load;
+		heap_update(&place_heap, asign);
 	}
 }
 
+/*
+ * Optional refinement of the placement above, for --solverbudget.  The
+ * greedy walk places each irq once per level and never looks back, so a
+ * cpu can end up carrying much more than its siblings.  Starting from the
+ * placement as it stands, irqs are moved or swapped off the busiest cpu
+ * as long as that lowers its load and narrows its gap to the other cpu,
+ * penalties included, by more than MIGRATION_COST per irq moved, until
+ * no such step is left or the time budget is spent.  Like any other
+ * move, irqs still cooling down from their last move stay where they
+ * are, and irqs with a usable numa node stay on it.  Every step keeps the
+ * placement valid, so running out of budget keeps what was found so far,
+ * and the greedy placement stands when nothing better turns up.
+ */
+struct solver_cpu {
+	struct topo_obj *obj;
+	uint64_t load;		/* irq load the cpu is expected to carry */
+};
+
+struct solver_state {
+	struct solver_cpu *cpus;
+	int nr;
+	int size;
+	int *slot;		/* cpu number to index in cpus */
+	int slot_size;
+};
+
+static struct solver_state solver;
+
+/*жܷCPU֮ȴڵжϼʹҲᱻд룬*/
+static inline int solver_movable(struct irq_info *info)
+{
+	if (info->hint_policy == HINT_POLICY_EXACT && !cpus_empty(info->affinity_hint))
+		return 0;
+	if (irq_cooling_down(info))
+		return 0;
+	return info->load > 0;
+}
+
+/*жܷŵCPU d*/
+static inline int solver_allowed(struct irq_info *info, struct topo_obj *d)
+{
+	struct topo_obj *node = irq_numa_node(info);
+
+	if (!object_usable(d))
+		return 0;
+	/*place_irq_in_node()һжĽڵʱ뿪ýڵ*/
+	if (node->number != -1 && cpus_intersects(node->mask, unbanned_cpus) &&
+	    obj_ancestor(d, OBJ_TYPE_NODE) != node)
+		return 0;
+	return !irq_has_subset_hint(info) || cpus_intersects(info->affinity_hint, d->mask);
+}
+
+/*жϷŵCPU dҪ⸶Ĵۣ뿪ԭڵpackage*/
+static uint64_t solver_penalty(struct topo_obj *d, struct irq_info *info)
+{
+	struct topo_obj *package = obj_ancestor(d, OBJ_TYPE_PACKAGE);
+	uint64_t cost = placement_cost(d, info) - d->load;
+
+	if (package && info->home_package >= 0 && package->number != info->home_package)
+		cost += scale_penalty(CROSS_PACKAGE_PENALTY);
+	return cost;
+}
+
+/*dһжϵĸأƽ̯dµÿCPU*/
+static uint64_t solver_spread_load(struct topo_obj *d)
+{
+	struct irq_link *link;
+	uint64_t load = 0;
+	int weight = cpus_weight(d->mask);
+
+	for (link = d->interrupts.first; link; link = link->next)
+		load += link->info->load;
+	return weight ? load / weight : 0;
+}
+
+/*ÿCPUԤƸأCPUϵжϣϲжƽ̯Ĳ*/
+static int solver_build(void)
+{
+	struct solver_cpu *c;
+	struct topo_obj *d;
+	struct irq_link *link;
+	GList *entry;
+
+	solver.nr = 0;
+	for (entry = g_list_first(cpus); entry; entry = g_list_next(entry)) {
+		d = entry->data;
+		if (grow_array((void **)&solver.cpus, &solver.size, solver.nr + 1,
+			       sizeof(struct solver_cpu)) ||
+		    grow_array((void **)&solver.slot, &solver.slot_size, d->number + 1,
+			       sizeof(int)))
+			return -1;
+		solver.slot[d->number] = solver.nr;
+		c = &solver.cpus[solver.nr++];
+		c->obj = d;
+		c->load = 0;
+		for (link = d->interrupts.first; link; link = link->next)
+			c->load += link->info->load;
+		for (d = d->parent; d; d = d->parent)
+			c->load += solver_spread_load(d);
+	}
+	return 0;
+}
+
+/*CPUиصһûпCPUʱ-1*/
+static int solver_hottest(void)
+{
+	int i, hot = -1;
+
+	for (i = 0; i < solver.nr; i++) {
+		if (!object_usable(solver.cpus[i].obj))
+			continue;
+		if (hot < 0 || solver.cpus[i].load > solver.cpus[hot].load)
+			hot = i;
+	}
+	return hot;
+}
+
+static void solver_ratio(int hot, long double *ratio)
+{
+	uint64_t total = 0;
+	int i, usable = 0;
+
+	for (i = 0; i < solver.nr; i++) {
+		if (!object_usable(solver.cpus[i].obj))
+			continue;
+		total += solver.cpus[i].load;
+		usable++;
+	}
+	*ratio = (total && usable) ?
+		(long double)solver.cpus[hot].load * usable / total : 1;
+}
+
+/*жϴԭCPUƵCPU toϣ;ĸ֮*/
+static void solver_move(struct irq_info *info, struct topo_obj *to)
+{
+	struct topo_obj *from = info->assigned_obj, *d;
+
+	for (d = from; d; d = d->parent)
+		d->load = (d->load > info->load) ? d->load - info->load : 0;
+	for (d = to; d; d = d->parent)
+		d->load += info->load;
+	solver.cpus[solver.slot[from->number]].load -= info->load;
+	solver.cpus[solver.slot[to->number]].load += info->load;
+	migrate_irq(&from->interrupts, &to->interrupts, info);
+	set_irq_obj(info, to);
+}
+
+/*
+ * Net gain of a step that leaves the busiest cpu s at ns and cpu t at nt,
+ * moving the given number of irqs: how much it narrows the load gap
+ * between them, less MIGRATION_COST per irq moved, the same profit test
+ * move_candidate_irqs() applies.  0 if it doesn't pay or doesn't lower
+ * the busier of the two.
+ */
+static uint64_t solver_gain(struct solver_cpu *s, struct solver_cpu *t,
+			    uint64_t ns, uint64_t nt, int moves)
+{
+	uint64_t gap = s->load - t->load, new_gap = ns > nt ? ns - nt : nt - ns;
+
+	if ((ns > nt ? ns : nt) >= s->load || new_gap >= gap ||
+	    !migration_profitable(gap - new_gap, moves))
+		return 0;
+	return gap - new_gap - moves * scale_penalty(MIGRATION_COST);
+}
+
+/*
+ * One step: of all moves of an irq off the busiest cpu, and all swaps of
+ * one of its irqs with a lighter irq of another cpu, take the one with
+ * the largest net gain, each judged by the irqs it moves.  Returns 1 if
+ * a step was taken, 0 at a local optimum and -1 when the deadline passed
+ * first.
+ */
+static int solver_step(int hot, uint64_t deadline)
+{
+	struct solver_cpu *s = &solver.cpus[hot], *t;
+	struct irq_link *la, *lb;
+	struct irq_info *a, *b, *best_a = NULL, *best_b = NULL;
+	struct topo_obj *best_t = NULL;
+	uint64_t best_gain = 0, gain, ns, nt, pen;
+	int i;
+
+	for (la = s->obj->interrupts.first; la; la = la->next) {
+		a = la->info;
+		if (!solver_movable(a))
+			continue;
+		if (monotonic_ns() >= deadline)
+			return -1;
+		for (i = 0; i < solver.nr; i++) {
+			t = &solver.cpus[i];
+			if (t == s || !solver_allowed(a, t->obj))
+				continue;
+			pen = solver_penalty(t->obj, a);
+
+			/*ֻжa*/
+			nt = t->load + a->load + pen;
+			ns = s->load - a->load;
+			gain = solver_gain(s, t, ns, nt, 1);
+			if (gain > best_gain) {
+				best_gain = gain;
+				best_a = a;
+				best_b = NULL;
+				best_t = t->obj;
+			}
+
+			/*tϸؽжb*/
+			for (lb = t->obj->interrupts.first; lb; lb = lb->next) {
+				b = lb->info;
+				if (b->load >= a->load || !solver_movable(b) ||
+				    !solver_allowed(b, s->obj))
+					continue;
+				nt = t->load - b->load + a->load + pen;
+				ns = s->load - a->load + b->load + solver_penalty(s->obj, b);
+				gain = solver_gain(s, t, ns, nt, 2);
+				if (gain > best_gain) {
+					best_gain = gain;
+					best_a = a;
+					best_b = b;
+					best_t = t->obj;
+				}
+			}
+		}
+	}
+
+	if (!best_a)
+		return 0;
+	if (best_b)
+		solver_move(best_b, s->obj);
+	solver_move(best_a, best_t);
+	return 1;
+}
+
+/*ʱԤڵCPUϵжϣæCPUĸ*/
+static void solve_placement(void)
+{
+	uint64_t start = monotonic_ns(), deadline;
+	long double before, after;
+	int ret, hot, steps = 0;
+
+	if (solver_build() || solver.nr < 2 || (hot = solver_hottest()) < 0)
+		return;
+	deadline = start + (uint64_t)solver_budget * 1000000;
+	solver_ratio(hot, &before);
+	while ((ret = solver_step(hot, deadline)) > 0) {
+		steps++;
+		hot = solver_hottest();
+	}
+	solver_ratio(hot, &after);
+	log(TO_CONSOLE, LOG_INFO,
+	    "placement solver: busiest cpu at %.2Lf -> %.2Lf of average, %d steps in %lu us%s\n",
+	    before, after, steps, (unsigned long)((monotonic_ns() - start) / 1000),
+	    ret < 0 ? ", budget spent" : "");
+}
+
 /*жϹǷȷ*/
 static void validate_irq(struct irq_info *info, void *data)
 {
@@ -171,8 +686,8 @@ static void validate_irq(struct irq_info *info, void *data)
 /*ежǷȷʵڸ*/
 static void validate_object(struct topo_obj *d, void *data __attribute__((unused)))
 {
-	if (g_list_length(d->interrupts) > 0)
-		for_each_irq(d->interrupts, validate_irq, d);
+	if (d->interrupts.count > 0)
+		for_each_irq(&d->interrupts, validate_irq, d);
 }
 
 /*˽ṹжϹǷȷ*/
@@ -187,11 +702,16 @@ static void validate_object_tree_placement(void)
 void calculate_placement(void)
 {
 	sort_irq_list(&rebalance_irq_list);
-	if (g_list_length(rebalance_irq_list) > 0) {
-		for_each_irq(rebalance_irq_list, place_irq_in_node, NULL);
+	if (rebalance_irq_list.count > 0) {
+		heap_build(&place_heap, numa_nodes);
+		for_each_irq(&rebalance_irq_list, place_irq_in_node, NULL);
 		for_each_object(numa_nodes, place_irq_in_object, NULL);
 		for_each_object(packages, place_irq_in_object, NULL);
 		for_each_object(cache_domains, place_irq_in_object, NULL);
+
+		/*ֻиؼΪҪ¾ʱ̰ĽĻϼ*/
+		if (solver_budget)
+			solve_placement();
 	}
 	if (debug_mode)
 		validate_object_tree_placement();
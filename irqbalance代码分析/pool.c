@@ -0,0 +1,84 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "irqbalance.h"
+
+/*
+ * Fixed size object pools for the topology objects and the irqs.  A
+ * rescan used to free and calloc every one of them again; now a rescan
+ * only resets the pools and the next build carves its objects out of
+ * the same chunks.
+ */
+
+#define POOL_OBJ(chunk, pool, i) ((void *)((chunk)->objs + (size_t)(i) * (pool)->obj_size))
+
+/*ڴзһĶʹͷŻĶǵǰڴδõĲ*/
+void *obj_pool_alloc(struct obj_pool *pool)
+{
+	struct obj_pool_chunk *chunk;
+	void *obj, *mem;
+
+	if (pool->free_objs) {
+		obj = pool->free_objs;
+		pool->free_objs = *(void **)obj;
+		memset(obj, 0, pool->obj_size);
+		return obj;
+	}
+
+	/*ǰڴ֮ڴ鶼úеģ˲Ҫµڴ*/
+	chunk = pool->cur;
+	if (chunk && chunk->used == OBJ_POOL_CHUNK)
+		chunk = chunk->next;
+	if (!chunk) {
+		if (posix_memalign(&mem, 64, sizeof(struct obj_pool_chunk) +
+				   OBJ_POOL_CHUNK * pool->obj_size))
+			return NULL;
+		chunk = mem;
+		chunk->next = NULL;
+		chunk->used = 0;
+		if (pool->cur)
+			pool->cur->next = chunk;
+		else
+			pool->chunks = chunk;
+	}
+	pool->cur = chunk;
+
+	obj = POOL_OBJ(chunk, pool, chunk->used++);
+	memset(obj, 0, pool->obj_size);
+	return obj;
+}
+
+/*Żڴأжͨ俪ͷָ*/
+void obj_pool_free(struct obj_pool *pool, void *obj)
+{
+	*(void **)obj = pool->free_objs;
+	pool->free_objs = obj;
+}
+
+/*һԻڴежڴ鱣һνʱʹ*/
+void obj_pool_reset(struct obj_pool *pool)
+{
+	struct obj_pool_chunk *chunk;
+
+	for (chunk = pool->chunks; chunk; chunk = chunk->next)
+		chunk->used = 0;
+	pool->cur = pool->chunks;
+	pool->free_objs = NULL;
+}
+
+/*ͷڴеڴ*/
+void obj_pool_release(struct obj_pool *pool)
+{
+	struct obj_pool_chunk *chunk;
+
+	while (pool->chunks) {
+		chunk = pool->chunks;
+		pool->chunks = chunk->next;
+		free(chunk);
+	}
+	pool->cur = NULL;
+	pool->free_objs = NULL;
+}
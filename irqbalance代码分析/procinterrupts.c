@@ -6,43 +6,392 @@
 #include <string.h>
 #include <syslog.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <math.h>
 
 #include "cpumask.h"
 #include "irqbalance.h"
 
 #define LINESIZE 4096
+#define SYSFS_IRQ_DIR "/sys/kernel/irq"
 
 static int proc_int_has_msi = 0;
 static int msi_found_in_sysfs = 0;
 
-/*жĿ¼ȡжϢжϢṹϢж*/
-GList* collect_full_irq_list()
+/*
+ * A procfs file that stays open across cycles and is read whole into a
+ * buffer that is reused, and only ever grown, from one cycle to the next
+ */
+struct proc_file {
+	const char *path;
+	int fd;
+	char *buf;
+	size_t size;
+	size_t len;
+};
+
+static struct proc_file proc_interrupts = { .path = "/proc/interrupts", .fd = -1 };
+static struct proc_file proc_stat = { .path = "/proc/stat", .fd = -1 };
+static struct proc_file proc_softirqs = { .path = "/proc/softirqs", .fd = -1 };
+
+/* cpu number of each count column, from the /proc/interrupts header */
+static int *column_cpus = NULL;
+static int column_cpus_size = 0;
+static int nr_columns = 0;
+
+/* non-zero counts of the line being parsed */
+static struct irq_cpu_count *line_counts = NULL;
+static int line_counts_size = 0;
+
+/*
+ * This cycle's interrupt and irq time accounting of one cpu, indexed by
+ * cpu number
+ */
+struct cpu_irq_stat {
+	uint64_t irq_deltas;			/* interrupts of all numbered irqs */
+	uint64_t group_deltas[SOFTIRQ_GROUPS];	/* interrupts of the irqs of each group */
+	uint64_t hardirq_ns;
+	uint64_t softirq_ns[SOFTIRQ_GROUPS];
+	uint64_t last_irq_jiffies;
+	uint64_t last_softirq_jiffies;
+	uint64_t softirq_counts[NR_SOFTIRQ_VECS];	/* last /proc/softirqs row */
+	uint64_t softirq_deltas[NR_SOFTIRQ_VECS];
+	double predicted_ns;			/* irq time the learned costs account for */
+	double delta_sq;			/* sum of the squared irq deltas */
+	double error_ns;			/* measured irq time less predicted_ns */
+	int timed;				/* hardirq/softirq_ns were taken this cycle */
+};
+
+static struct cpu_irq_stat *cpu_stats = NULL;
+static int cpu_stats_size = 0;
+
+/* cpu number of each /proc/softirqs column */
+static int *softirq_cpus = NULL;
+static int softirq_cpus_size = 0;
+
+/* group of each softirq vector, refreshed from the /proc/softirqs row names */
+static enum softirq_group_e softirq_vec_group[NR_SOFTIRQ_VECS] = {
+	SOFTIRQ_GROUP_DEVICE,	/* HI */
+	SOFTIRQ_GROUP_NONE,	/* TIMER */
+	SOFTIRQ_GROUP_NET,	/* NET_TX */
+	SOFTIRQ_GROUP_NET,	/* NET_RX */
+	SOFTIRQ_GROUP_BLOCK,	/* BLOCK */
+	SOFTIRQ_GROUP_BLOCK,	/* IRQ_POLL */
+	SOFTIRQ_GROUP_DEVICE,	/* TASKLET */
+	SOFTIRQ_GROUP_NONE,	/* SCHED */
+	SOFTIRQ_GROUP_NONE,	/* HRTIMER */
+	SOFTIRQ_GROUP_NONE,	/* RCU */
+};
+
+/* online cpus in /proc/stat the last hotplug rescan was asked for, or -1 */
+static int rescanned_online = -1;
+
+/*ÿһ/proc/interruptsһҳѾʧж*/
+static uint64_t parse_generation = 0;
+
+/*ν/proc/stat֮ʵʾʱ䣬ؾʱڵжϴʱ*/
+uint64_t sample_period_ns = SLEEP_INTERVAL * 1000000000ULL;
+static uint64_t last_stat_ns = 0;
+
+/*ڻƽеȨأɰ˥ںͲھ*/
+static double ewma_alpha = 1;
+
+/* /sys/kernel/irq, when irq counts are sampled from per_cpu_count */
+static DIR *sysfs_irq_dir = NULL;
+static char *sysfs_buf = NULL;
+static int sysfs_buf_size = 0;
+static char *sysfs_chip = NULL;
+static int sysfs_chip_size = 0;
+
+/*֤neededԪأʱ2ݴ0ʧܷ-1*/
+int grow_array(void **array, int *size, int needed, size_t elem_size)
 {
-	GList *tmp_list = NULL;
-	FILE *file;
-	char *line = NULL;
-	size_t size = 0;
-	char *irq_name, *savedptr, *last_token, *p;
+	void *new_array;
+	int new_size;
 
-	file = fopen("/proc/interrupts", "r");
-	if (!file)
-		return NULL;
+	if (needed <= *size)
+		return 0;
 
-	/*һCPUţҪ */
-	if (getline(&line, &size, file)==0) {
-		free(line);
-		fclose(file);
+	new_size = *size ? *size : 16;
+	while (new_size < needed)
+		new_size <<= 1;
+	new_array = realloc(*array, new_size * elem_size);
+	if (!new_array)
+		return -1;
+	memset((char *)new_array + *size * elem_size, 0, (new_size - *size) * elem_size);
+	*array = new_array;
+	*size = new_size;
+	return 0;
+}
+
+/*ȡʱӵֵͳƽʱ*/
+uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*ļͷʼprocļ뻺ʱһضȡֽʧܷ-1*/
+static ssize_t proc_file_read(struct proc_file *pf)
+{
+	ssize_t ret;
+	size_t size;
+	char *buf;
+
+	if (pf->fd < 0) {
+		pf->fd = open(pf->path, O_RDONLY | O_CLOEXEC);
+		if (pf->fd < 0)
+			return -1;
+	}
+
+	pf->len = 0;
+	do {
+		if (pf->size - pf->len < LINESIZE) {
+			size = pf->size ? pf->size * 2 : 4 * LINESIZE;
+			buf = realloc(pf->buf, size);
+			if (!buf)
+				return -1;
+			pf->buf = buf;
+			pf->size = size;
+		}
+		ret = pread(pf->fd, pf->buf + pf->len, pf->size - pf->len - 1, pf->len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			close(pf->fd);
+			pf->fd = -1;
+			return -1;
+		}
+		pf->len += ret;
+	} while (ret > 0);
+
+	pf->buf[pf->len] = '\0';
+	return pf->len;
+}
+
+/*ӻȡһУβĻз滻Ϊ'\0'ûиʱNULL
+endΪգͨβ'\0'λ*/
+static char *proc_file_next_line(char **cursor, char **end)
+{
+	char *line = *cursor;
+	char *eol;
+
+	if (!*line)
 		return NULL;
+
+	eol = strchr(line, '\n');
+	if (eol) {
+		*eol = '\0';
+		*cursor = eol + 1;
+	} else {
+		eol = line + strlen(line);
+		*cursor = eol;
+	}
+
+	if (end)
+		*end = eol;
+	return line;
+}
+
+/*
+ * Scan back from the end of a /proc/interrupts line over the last two
+ * blank separated fields and return the first of them (the irq chip for
+ * most irqs), terminated in place.  Unlike tokenizing from the front
+ * this doesn't depend on the number of cpu columns or the line length.
+ */
+static char *proc_irq_chip_name(char *line, char *end)
+{
+	char *p = end;
+	char *field_end = end;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		while (p > line && isblank(p[-1]))
+			p--;
+		field_end = p;
+		while (p > line && !isblank(p[-1]))
+			p--;
 	}
 
-	while (!feof(file)) {
+	*field_end = '\0';
+	return p;
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+/*ж8ֽǷʮַ*/
+static inline int swar_all_digits(uint64_t chunk)
+{
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+		(((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+		0x3333333333333333ULL;
+}
+
+/*һΰ8ַתֵڵλϲֻγ˷*/
+static inline uint64_t swar_parse8(uint64_t chunk)
+{
+	chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+	chunk = (chunk & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+	return (chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+#endif
+
+/*
+ * Parse the next space padded decimal count before end.  Returns 0
+ * without moving *pos once the next field isn't a number, i.e. at the
+ * end of the per-cpu columns.
+ */
+static inline int parse_count(char **pos, const char *end, uint64_t *val)
+{
+	char *p = *pos;
+	uint64_t v = 0;
+
+	while (p < end && *p == ' ')
+		p++;
+	if (p >= end || !isdigit(*p))
+		return 0;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	while (end - p >= 8) {
+		uint64_t chunk;
+
+		memcpy(&chunk, p, 8);
+		if (!swar_all_digits(chunk))
+			break;
+		v = v * 100000000ULL + swar_parse8(chunk);
+		p += 8;
+	}
+#endif
+	while (p < end && isdigit(*p)) {
+		v = v * 10 + (*p - '0');
+		p++;
+	}
+
+	*pos = p;
+	*val = v;
+	return 1;
+}
+
+/*/proc/interrupts/proc/softirqsУ¼ÿһмӦCPUţ*/
+static int parse_cpu_columns(char *line, int **cols, int *cols_size)
+{
+	char *p = line;
+	int cpu, nr = 0;
+
+	while ((p = strstr(p, "CPU"))) {
+		cpu = strtoul(p + 3, &p, 10);
+		if (grow_array((void **)cols, cols_size, nr + 1, sizeof(int)) ||
+		    grow_array((void **)&cpu_stats, &cpu_stats_size,
+			       cpu + 1, sizeof(struct cpu_irq_stat)))
+			return 0;
+		(*cols)[nr++] = cpu;
+	}
+	return nr;
+}
+
+/*ÿһֽжϼ֮ǰһÿCPUϵж*/
+static void clear_cpu_irq_deltas(void)
+{
+	int i;
+
+	for (i = 0; i < cpu_stats_size; i++) {
+		cpu_stats[i].irq_deltas = 0;
+		memset(cpu_stats[i].group_deltas, 0, sizeof(cpu_stats[i].group_deltas));
+	}
+}
+
+/*жϵжϸط飬жϳежϣ洢жϳе豸ж*/
+static enum softirq_group_e irq_softirq_group(struct irq_info *info)
+{
+	switch (info->class) {
+	case IRQ_ETH:
+	case IRQ_GBETH:
+	case IRQ_10GBETH:
+		return SOFTIRQ_GROUP_NET;
+	case IRQ_SCSI:
+		return SOFTIRQ_GROUP_BLOCK;
+	default:
+		return SOFTIRQ_GROUP_DEVICE;
+	}
+}
+
+/*
+ * Replace the per-cpu counts of info with the ones just parsed into
+ * line_counts, computing each cpu's delta against the previous cycle and
+ * adding it to that cpu's total for the cycle
+ */
+static void update_irq_cpu_counts(struct irq_info *info, int nr_counts, int fresh)
+{
+	struct irq_cpu_count *cc;
+	uint64_t prev;
+	int i, j = 0;
+	enum softirq_group_e group = irq_softirq_group(info);
+
+	for (i = 0; i < nr_counts; i++) {
+		cc = &line_counts[i];
+		/*¼жûһεļ*/
+		if (fresh) {
+			cc->delta = 0;
+			continue;
+		}
+		while (j < info->nr_cpu_counts && info->cpu_counts[j].cpu < cc->cpu)
+			j++;
+		if (j < info->nr_cpu_counts && info->cpu_counts[j].cpu == cc->cpu)
+			prev = info->cpu_counts[j].count;
+		else
+			prev = 0;
+		cc->delta = (cc->count >= prev) ? cc->count - prev : 0;
+		if (cc->cpu < cpu_stats_size) {
+			cpu_stats[cc->cpu].irq_deltas += cc->delta;
+			cpu_stats[cc->cpu].group_deltas[group] += cc->delta;
+		}
+	}
+
+	if (grow_array((void **)&info->cpu_counts, &info->cpu_counts_size,
+		       nr_counts, sizeof(struct irq_cpu_count))) {
+		info->nr_cpu_counts = 0;
+		return;
+	}
+	memcpy(info->cpu_counts, line_counts, nr_counts * sizeof(struct irq_cpu_count));
+	info->nr_cpu_counts = nr_counts;
+}
+
+/*жϿжϵ͵ϢΪû豸жϵķ*/
+static void init_irq_hint(struct irq_info *info, int irq, const char *irq_name)
+{
+	info->irq = irq;
+	if (strstr(irq_name, "xen-dyn-event") != NULL) {
+		info->type = IRQ_TYPE_VIRT_EVENT;
+		info->class = IRQ_VIRT_EVENT;
+	} else {
+		info->type = IRQ_TYPE_LEGACY;
+		info->class = IRQ_OTHER;
+	}
+	info->hint_policy = global_hint_policy;
+}
+
+/*жĿ¼ȡжϢжϢṹϢж*/
+void collect_full_irq_list(struct irq_list *list, struct obj_pool *pool)
+{
+	char *line, *end, *cursor;
+	char *irq_name;
+
+	if (proc_file_read(&proc_interrupts) < 0)
+		return;
+	cursor = proc_interrupts.buf;
+
+	/*һCPUţҪ */
+	if (!proc_file_next_line(&cursor, NULL))
+		return;
+
+	while ((line = proc_file_next_line(&cursor, &end))) {
 		int	 number;
 		struct irq_info *info;
 		char *c;
-		char savedline[1024];
-
-		if (getline(&line, &size, file)==0)
-			break;
 
 		/*ʼȡжϺŻ */
 		c = line;
@@ -57,14 +406,8 @@ GList* collect_full_irq_list()
 		if (!c)
 			continue;
 
-		/*жϢϢݽзָ*/
-		strncpy(savedline, line, sizeof(savedline));
-		irq_name = strtok_r(savedline, " ", &savedptr);
-		last_token = strtok_r(NULL, " ", &savedptr);
-		while ((p = strtok_r(NULL, " ", &savedptr))) {
-			irq_name = last_token;
-			last_token = p;
-		}
+		/*βǰҵжϿƣ追УҲûг*/
+		irq_name = proc_irq_chip_name(c, end);
 
 		/*жϺŰʮƱ棬CֵΪ0ͽжϺϢָ*/
 		*c = 0;
@@ -72,61 +415,261 @@ GList* collect_full_irq_list()
 		number = strtoul(line, NULL, 10);
 
 		/*жϢṹжϺԼϢ*/
-		info = calloc(sizeof(struct irq_info), 1);
+		info = obj_pool_alloc(pool);
 		if (info) {
-			info->irq = number;
-			if (strstr(irq_name, "xen-dyn-event") != NULL) {
-				info->type = IRQ_TYPE_VIRT_EVENT;
-				info->class = IRQ_VIRT_EVENT;
-			} else {
-				info->type = IRQ_TYPE_LEGACY;
-				info->class = IRQ_OTHER;
-			} 
-			info->hint_policy = global_hint_policy;
+			init_irq_hint(info, number, irq_name);
 
 		/*ʶжϼ*/
-			tmp_list = g_list_append(tmp_list, info);
+			irq_list_append(list, info);
 		}
 
 	}
-	fclose(file);
-	free(line);
-	return tmp_list;
+}
+
+/*ûм¼жϣ߼С(жϺűͷź·)жϣҪ¼ݿ*/
+static inline int irq_needs_hint(struct irq_info *info, uint64_t count)
+{
+	return !info || count < info->irq_count;
+}
+
+/*
+ * Record one sample of irq number, whose per-cpu counts are in line_counts.
+ * info is its current entry, if any, and chip its interrupt controller name
+ * when irq_needs_hint() said so.  Returns -1 if the irq can't be added
+ * without a full rescan.
+ */
+static int update_irq_sample(struct irq_info *info, int number, uint64_t count,
+			     int nr_counts, const char *chip, int *devices_scanned)
+{
+	struct irq_info hint;
+	int fresh = 0;
+
+	/*С˵жϺűͷź·䣬ȰѾɵжƳжϴ*/
+	if (info && count < info->irq_count) {
+		remove_irq_from_db(info);
+		info = NULL;
+	}
+
+	/*³ֵжֻݿ⣬ؽ˽ṹ*/
+	if (!info) {
+		memset(&hint, 0, sizeof(hint));
+		init_irq_hint(&hint, number, chip ? chip : "");
+		info = add_new_irq_incremental(&hint, devices_scanned);
+		if (!info)
+			return -1;
+		fresh = 1;
+	}
+
+	/*жԼȲκ¼жϣԱβΪ׼*/
+	irq_set_counts(info, (fresh || !info->irq_count) ? count : info->irq_count, count);
+	info->seen_generation = parse_generation;
+	update_irq_cpu_counts(info, nr_counts, fresh);
+
+	/* MSI/MSI-Xжϣб*/
+	if ((info->type == IRQ_TYPE_MSI) || (info->type == IRQ_TYPE_MSIX))
+		msi_found_in_sysfs = 1;
+	return 0;
+}
+
+static void rebase_irq_count(struct irq_info *info, void *data __attribute__((unused)))
+{
+	irq_set_counts(info, 0, 0);
+}
+
+/*
+ * The columns of /proc/interrupts follow the online cpus, so after a
+ * hotplug an irq's total may go down without it having been freed.
+ * Take the next sample as the new baseline instead.
+ */
+void rebase_irq_counts(void)
+{
+	for_each_irq(NULL, rebase_irq_count, NULL);
+}
+
+/*ȡsysfsеһжļbufУضȡĳȣʧܷ-1*/
+static ssize_t read_sysfs_irq_attr(int irq, const char *attr, char **buf, int *size)
+{
+	char name[64];
+	ssize_t len = 0, rc;
+	int fd;
+
+	snprintf(name, sizeof(name), "%d/%s", irq, attr);
+	fd = openat(dirfd(sysfs_irq_dir), name, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	for (;;) {
+		if (grow_array((void **)buf, size, len + LINESIZE, 1)) {
+			len = -1;
+			break;
+		}
+		rc = read(fd, *buf + len, *size - len - 1);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			len = -1;
+			break;
+		}
+		if (rc == 0)
+			break;
+		len += rc;
+	}
+	close(fd);
+	if (len >= 0)
+		(*buf)[len] = '\0';
+	return len;
+}
+
+/* progress of one pass over the per_cpu_count files */
+struct sysfs_sample {
+	int devices_scanned;
+	int failed;
+	unsigned long bytes;
+};
+
+/*ȡһ֪жϵper_cpu_count¼ֵĲ*/
+static void sample_sysfs_irq(struct irq_info *info, void *data)
+{
+	struct sysfs_sample *s = data;
+	char *c, *end, *chip;
+	int number = info->irq, cpu = 0, nr_counts = 0;
+	uint64_t count = 0, C;
+	ssize_t len;
+
+	/*¼ݿжĩβѾ*/
+	if (s->failed || info->seen_generation == parse_generation)
+		return;
+
+	/*жڶȡǰͷţֽᱻƳ*/
+	len = read_sysfs_irq_attr(number, "per_cpu_count", &sysfs_buf, &sysfs_buf_size);
+	if (len < 0)
+		return;
+	s->bytes += len;
+
+	c = sysfs_buf;
+	end = sysfs_buf + len;
+	while (parse_count(&c, end, &C)) {
+		count += C;
+		if (C && !grow_array((void **)&line_counts, &line_counts_size,
+				     nr_counts + 1, sizeof(struct irq_cpu_count)) &&
+		    !grow_array((void **)&cpu_stats, &cpu_stats_size,
+				cpu + 1, sizeof(struct cpu_irq_stat))) {
+			line_counts[nr_counts].cpu = cpu;
+			line_counts[nr_counts].count = C;
+			nr_counts++;
+		}
+		cpu++;
+		if (c < end && *c == ',')
+			c++;
+	}
+	if (cpu > nr_columns)
+		nr_columns = cpu;
+
+	chip = NULL;
+	if (irq_needs_hint(info, count) &&
+	    read_sysfs_irq_attr(number, "chip_name", &sysfs_chip, &sysfs_chip_size) >= 0)
+		chip = sysfs_chip;
+	if (update_irq_sample(info, number, count, nr_counts, chip, &s->devices_scanned)) {
+		need_rescan = 1;
+		s->failed = 1;
+	}
+}
+
+/*
+ * The per_cpu_count backend: instead of having the kernel format all of
+ * /proc/interrupts, read the comma separated per_cpu_count, one count per
+ * possible cpu, of each irq already in the database.  Banned irqs are
+ * read too, their interrupts count towards the cpu totals the irq time
+ * is shared out by, they are just never placed.  /sys/kernel/irq also
+ * holds descriptors no handler was ever requested for, so it is not
+ * walked: irqs of new pci devices come in through the uevents, anything
+ * else with the next full rescan.  cpu hotplug is noticed by
+ * parse_proc_stat() in this mode.
+ */
+static void parse_sysfs_irq_counts(void)
+{
+	struct sysfs_sample s;
+	uint64_t start;
+
+	start = monotonic_ns();
+	clear_cpu_irq_deltas();
+	parse_generation++;
+
+	memset(&s, 0, sizeof(s));
+	for_each_irq(NULL, sample_sysfs_irq, &s);
+	for_each_banned_irq(sample_sysfs_irq, &s);
+
+	/*һ󣬱ûгֵжѾƳ*/
+	if (!s.failed)
+		retire_stale_irqs(parse_generation);
+
+	log(TO_CONSOLE, LOG_INFO, "Read %lu bytes from %s, parsed in %lu us\n",
+	    s.bytes, SYSFS_IRQ_DIR, (unsigned long)((monotonic_ns() - start) / 1000));
+}
+
+/*
+ * Pick the per_cpu_count backend when the kernel exposes irq descriptors
+ * in /sys/kernel/irq, otherwise keep parsing /proc/interrupts
+ */
+void init_irq_sampler(void)
+{
+	struct dirent *entry;
+	char name[NAME_MAX + sizeof("/per_cpu_count")];
+
+	sysfs_irq_dir = opendir(SYSFS_IRQ_DIR);
+	if (!sysfs_irq_dir)
+		goto use_procfs;
+
+	while ((entry = readdir(sysfs_irq_dir))) {
+		if (!isdigit(entry->d_name[0]))
+			continue;
+		snprintf(name, sizeof(name), "%s/per_cpu_count", entry->d_name);
+		if (!faccessat(dirfd(sysfs_irq_dir), name, R_OK, 0)) {
+			log(TO_CONSOLE, LOG_INFO, "Sampling irq counts from %s/*/per_cpu_count\n",
+			    SYSFS_IRQ_DIR);
+			return;
+		}
+		break;
+	}
+	closedir(sysfs_irq_dir);
+	sysfs_irq_dir = NULL;
+
+use_procfs:
+	log(TO_CONSOLE, LOG_INFO, "Sampling irq counts from %s\n", proc_interrupts.path);
 }
 
 /*жϳϢϵͳжǷȷ*/
 void parse_proc_interrupts(void)
 {
-	FILE *file;
-	char *line = NULL;
-	size_t size = 0;
+	char *line, *end, *cursor;
+	uint64_t start;
+	int devices_scanned = 0;
 
-	file = fopen("/proc/interrupts", "r");
-	if (!file)
+	if (sysfs_irq_dir) {
+		parse_sysfs_irq_counts();
 		return;
+	}
 
-	/*һCPUţҪ */
-	if (getline(&line, &size, file)==0) {
-		free(line);
-		fclose(file);
+	start = monotonic_ns();
+	if (proc_file_read(&proc_interrupts) < 0)
 		return;
-	}
+	cursor = proc_interrupts.buf;
 
-	while (!feof(file)) {
+	/*һCPUţ¼ÿһжӦCPU */
+	line = proc_file_next_line(&cursor, NULL);
+	if (!line)
+		return;
+	nr_columns = parse_cpu_columns(line, &column_cpus, &column_cpus_size);
+	clear_cpu_irq_deltas();
+	parse_generation++;
+
+	while ((line = proc_file_next_line(&cursor, &end))) {
 		int cpunr;
 		int	 number;
-		uint64_t count;
-		char *c, *c2;
+		int nr_counts;
+		uint64_t count, C;
+		char *c, *chip;
 		struct irq_info *info;
-		char savedline[1024];
-
-		if (getline(&line, &size, file)==0)
-			break;
-
-		/*жǷmsiж*/
-		if (!proc_int_has_msi)
-			if (strstr(line, "MSI") != NULL)
-				proc_int_has_msi = 1;
 
 		/*ʹжϺϢжϲҪܣҸжǰ棬һжƱעжϣNMILOCֱӺ*/	
 		c = line;
@@ -140,55 +683,53 @@ void parse_proc_interrupts(void)
 		if (!c)
 			continue;
 
-		strncpy(savedline, line, sizeof(savedline));
-
 		*c = 0;
 		c++;
 		/*ʮƷʽжϺϢ*/
 		number = strtoul(line, NULL, 10);
 
-		/*ͨжϺŻȡжϢṹõսṹ˵Ҫ½жϢ*/
-		info = get_irq_info(number);
-		if (!info) {
-			need_rescan = 1;
-			break;
-		}
 		/*ڼ¼һжϴܴԼϵͳеCPUĿ*/
 		count = 0;
 		cpunr = 0;
 
-		/*ȡжÿCPUϴĴۼ*/
-		c2=NULL;
-		while (1) {
-			uint64_t C;
-			C = strtoull(c, &c2, 10);
-			if (c==c2) /* end of numbers */
-				break;
+		/*ȡжÿCPUϴĴۼӣͬʱ¼0ÿCPU*/
+		nr_counts = 0;
+		while (parse_count(&c, end, &C)) {
 			count += C;
-			c=c2;
+			if (C && cpunr < nr_columns &&
+			    !grow_array((void **)&line_counts, &line_counts_size,
+					nr_counts + 1, sizeof(struct irq_cpu_count))) {
+				line_counts[nr_counts].cpu = column_cpus[cpunr];
+				line_counts[nr_counts].count = C;
+				nr_counts++;
+			}
 			cpunr++;
 		}
 
+		/*жǷmsiжϣֻ֮Ŀ豸*/
+		if (!proc_int_has_msi)
+			if (strstr(c, "MSI") != NULL)
+				proc_int_has_msi = 1;
+
 		/*ͳƵõCPUĿCPUĿƥ䣬ʱӦ½˽ṹ*/
 		if (cpunr != core_count) {
 			need_rescan = 1;
 			break;
 		}
 
-		/* ΪжƳͲֵʱӦ½˽ṹ */
-		if (count < info->irq_count) {
+		/*жϴϢжϲҪ*/
+		info = get_irq_info(number);
+		chip = irq_needs_hint(info, count) ? proc_irq_chip_name(c, end) : NULL;
+		if (update_irq_sample(info, number, count, nr_counts, chip, &devices_scanned)) {
 			need_rescan = 1;
 			break;
 		}
+	}		
 
-		/*жϴϢ*/
-		info->last_irq_count = info->irq_count;		
-		info->irq_count = count;
+	/*һ󣬱ûгֵжѾƳ*/
+	if (!need_rescan)
+		retire_stale_irqs(parse_generation);
 
-		/* MSI/MSI-Xжϣб*/
-		if ((info->type == IRQ_TYPE_MSI) || (info->type == IRQ_TYPE_MSIX))
-			msi_found_in_sysfs = 1;
-	}		
 	if ((proc_int_has_msi) && (!msi_found_in_sysfs) && (!need_rescan)) {
 		log(TO_ALL, LOG_WARNING, "WARNING: MSI interrupts found in /proc/interrupts\n");
 		log(TO_ALL, LOG_WARNING, "But none found in sysfs, you need to update your kernel\n");
@@ -198,23 +739,17 @@ void parse_proc_interrupts(void)
  		 */
 		msi_found_in_sysfs = 1;
 	}
-	fclose(file);
-	free(line);
-}
-
-/*һڡжϴĸΪؽм¼*/
-static void accumulate_irq_count(struct irq_info *info, void *data)
-{
-	uint64_t *acc = data;
 
-	*acc += (info->irq_count - info->last_irq_count);
+	log(TO_CONSOLE, LOG_INFO, "Read %lu bytes from %s, parsed in %lu us\n",
+	    (unsigned long)proc_interrupts.len, proc_interrupts.path,
+	    (unsigned long)((monotonic_ns() - start) / 1000));
 }
 
 /**/
 static void assign_load_slice(struct irq_info *info, void *data)
 {
 	uint64_t *load_slice = data;
-	info->load = (info->irq_count - info->last_irq_count) * *load_slice;
+	info->load = irq_count_delta(info) * *load_slice;
 
 	/*ÿһжϵĸضҪΪ*/
 	if (!info->load)
@@ -222,43 +757,344 @@ static void assign_load_slice(struct irq_info *info, void *data)
 }
 
 /*
- * Recursive helper to estimate the number of irqs shared between 
- * multiple topology objects that was handled by this particular object
+ * Estimate the number of irqs shared between multiple topology objects
+ * that was handled by each object: its own irqs plus an even slice of
+ * what its parent got.  One pass from the numa nodes down, the sums of
+ * the irqs of each object are kept up to date by its interrupt list.
  */
-static uint64_t get_parent_branch_irq_count_share(struct topo_obj *d)
+static void share_irq_count(struct topo_obj *d, uint64_t inherited)
 {
-	uint64_t total_irq_count = 0;
+	GList *entry;
+	uint64_t slice;
+	int nr_children = g_list_length(d->children);
 
-	if (d->parent) {
-		total_irq_count = get_parent_branch_irq_count_share(d->parent);
-		total_irq_count /= g_list_length((d->parent)->children);
-	}
+	d->irq_share = inherited + d->interrupts.delta;
+	if (!nr_children)
+		return;
 
-	if (g_list_length(d->interrupts) > 0)
-		for_each_irq(d->interrupts, accumulate_irq_count, &total_irq_count);
+	slice = d->irq_share / nr_children;
+	for (entry = g_list_first(d->children); entry; entry = g_list_next(entry))
+		share_irq_count(entry->data, slice);
+}
 
-	return total_irq_count;
+static void compute_irq_count_share(struct topo_obj *d, void *data __attribute__((unused)))
+{
+	share_irq_count(d, 0);
 }
 
 static void compute_irq_branch_load_share(struct topo_obj *d, void *data __attribute__((unused)))
 {
-	uint64_t local_irq_counts = 0;
 	uint64_t load_slice;
 	int	load_divisor = g_list_length(d->children);
 
 	d->load /= (load_divisor ? load_divisor : 1);
 
-	if (g_list_length(d->interrupts) > 0) 
+	/*ÿCPUʱжϸattribute_irq_load()ȷ*/
+	if (!nr_columns && d->interrupts.count > 0) 
 	{
-		local_irq_counts = get_parent_branch_irq_count_share(d);
-		load_slice = local_irq_counts ? (d->load / local_irq_counts) : 1;
-		for_each_irq(d->interrupts, assign_load_slice, &load_slice);
+		load_slice = d->irq_share ? (d->load / d->irq_share) : 1;
+		for_each_irq(&d->interrupts, assign_load_slice, &load_slice);
 	}
 
 	if (d->parent)
 		d->parent->load += d->load;
 }
 
+/*deltaռtotalı̯loadȳˣʱ*/
+static inline uint64_t load_share(uint64_t load, uint64_t delta, uint64_t total)
+{
+	if (!total)
+		return 0;
+	return (load / total) * delta + (load % total) * delta / total;
+}
+
+/*/proc/softirqsеȷжϵĸط*/
+static enum softirq_group_e softirq_group_of(const char *name)
+{
+	if (!strcmp(name, "NET_RX") || !strcmp(name, "NET_TX"))
+		return SOFTIRQ_GROUP_NET;
+	/* IRQ_POLL was called BLOCK_IOPOLL before linux 4.5 */
+	if (!strncmp(name, "BLOCK", 5) || !strcmp(name, "IRQ_POLL"))
+		return SOFTIRQ_GROUP_BLOCK;
+	if (!strcmp(name, "TIMER") || !strcmp(name, "HRTIMER") ||
+	    !strcmp(name, "SCHED") || !strcmp(name, "RCU"))
+		return SOFTIRQ_GROUP_NONE;
+	return SOFTIRQ_GROUP_DEVICE;
+}
+
+/*ȡ/proc/softirqs¼ÿCPUÿжϱڵִдɹ0*/
+static int parse_proc_softirqs(void)
+{
+	char *line, *end, *cursor, *c, *name;
+	int vec, col, nr_cols, cpu;
+	struct cpu_irq_stat *st;
+	uint64_t count;
+
+	if (proc_file_read(&proc_softirqs) < 0)
+		return -1;
+	cursor = proc_softirqs.buf;
+
+	line = proc_file_next_line(&cursor, NULL);
+	if (!line)
+		return -1;
+	nr_cols = parse_cpu_columns(line, &softirq_cpus, &softirq_cpus_size);
+	if (!nr_cols)
+		return -1;
+
+	/*ÿһжӦһжϣкžж*/
+	for (vec = 0; vec < NR_SOFTIRQ_VECS; vec++) {
+		line = proc_file_next_line(&cursor, &end);
+		if (!line)
+			break;
+		c = strchr(line, ':');
+		if (!c)
+			break;
+		*c++ = '\0';
+		name = line;
+		while (isblank(*name))
+			name++;
+		softirq_vec_group[vec] = softirq_group_of(name);
+
+		for (col = 0; col < nr_cols && parse_count(&c, end, &count); col++) {
+			cpu = softirq_cpus[col];
+			st = &cpu_stats[cpu];
+			st->softirq_deltas[vec] = count >= st->softirq_counts[vec] ?
+						  count - st->softirq_counts[vec] : 0;
+			st->softirq_counts[vec] = count;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Split this cycle's irq time of a cpu into hardirq time and the softirq
+ * time of each group.  With tracing both are measured.  Otherwise they
+ * come from the /proc/stat jiffies, and the softirq time is divided
+ * between the groups by how often each softirq ran.
+ */
+static void split_cpu_load(int cpunr, struct cpu_irq_stat *st,
+			   uint64_t irq_jiffies, uint64_t softirq_jiffies, int have_softirqs)
+{
+	uint64_t softirq_ns, runs = 0;
+	int vec;
+
+	memset(st->softirq_ns, 0, sizeof(st->softirq_ns));
+	if (irq_trace_active) {
+		st->hardirq_ns = irq_trace_hardirq_ns(cpunr);
+		for (vec = 0; vec < NR_SOFTIRQ_VECS; vec++)
+			st->softirq_ns[softirq_vec_group[vec]] +=
+				irq_trace_softirq_ns(cpunr, vec);
+	} else {
+		/*
+		 * the [soft]irq_load values are in jiffies, with
+		 * HZ jiffies per second.  Convert the load to nanoseconds
+		 * to get a better integer resolution of nanoseconds per
+		 * interrupt.
+		 */
+		st->hardirq_ns = irq_jiffies >= st->last_irq_jiffies ?
+			(irq_jiffies - st->last_irq_jiffies) * (NSEC_PER_SEC / HZ) : 0;
+		softirq_ns = softirq_jiffies >= st->last_softirq_jiffies ?
+			(softirq_jiffies - st->last_softirq_jiffies) * (NSEC_PER_SEC / HZ) : 0;
+
+		if (have_softirqs)
+			for (vec = 0; vec < NR_SOFTIRQ_VECS; vec++)
+				runs += st->softirq_deltas[vec];
+		if (!runs)
+			st->softirq_ns[SOFTIRQ_GROUP_DEVICE] = softirq_ns;
+		for (vec = 0; runs && vec < NR_SOFTIRQ_VECS; vec++)
+			st->softirq_ns[softirq_vec_group[vec]] +=
+				load_share(softirq_ns, st->softirq_deltas[vec], runs);
+	}
+}
+
+/*
+ * This cycle's irq time of a cpu, the part of it that moving irqs can
+ * change.  Timer, scheduler and RCU softirq time (SOFTIRQ_GROUP_NONE)
+ * stays with the cpu wherever its irqs go, so it is left out of the load
+ * the cpus are balanced by.
+ */
+static inline uint64_t cpu_irq_time(struct cpu_irq_stat *st)
+{
+	return st->hardirq_ns + st->softirq_ns[SOFTIRQ_GROUP_DEVICE] +
+	       st->softirq_ns[SOFTIRQ_GROUP_NET] + st->softirq_ns[SOFTIRQ_GROUP_BLOCK];
+}
+
+/*
+ * Charge each cpu's irq load to the irqs that actually fired on it this
+ * cycle, in proportion to their share of the cpu's interrupts
+ */
+static void attribute_irq_load(struct irq_info *info, void *data __attribute__((unused)))
+{
+	struct irq_cpu_count *cc;
+	struct cpu_irq_stat *st;
+	enum softirq_group_e group = irq_softirq_group(info);
+	int i;
+
+	/*
+	 * With tracing the handler time of the irq itself is known, only the
+	 * softirq time of each cpu is still shared out by interrupt counts.
+	 * Network and block softirq time goes to the irqs of that class only.
+	 */
+	info->load = irq_trace_active ? irq_trace_irq_ns(info->irq) : 0;
+	for (i = 0; i < info->nr_cpu_counts; i++) {
+		cc = &info->cpu_counts[i];
+		if (!cc->delta || cc->cpu >= cpu_stats_size)
+			continue;
+		st = &cpu_stats[cc->cpu];
+		if (!irq_trace_active)
+			info->load += load_share(st->hardirq_ns, cc->delta, st->irq_deltas);
+		info->load += load_share(st->softirq_ns[SOFTIRQ_GROUP_DEVICE], cc->delta,
+					 st->irq_deltas);
+		if (group != SOFTIRQ_GROUP_DEVICE)
+			info->load += load_share(st->softirq_ns[group], cc->delta,
+						 st->group_deltas[group]);
+	}
+
+	/*ÿһжϵĸضҪΪ*/
+	if (!info->load)
+		info->load++;
+}
+
+/*
+ * Fold one sample into a moving average.  The variance follows the
+ * incremental form of West (1979), so both need a single pass.
+ */
+static void update_ewma(struct ewma *e, double sample)
+{
+	double diff;
+
+	if (!e->primed) {
+		e->mean = sample;
+		e->var = 0;
+		e->primed = 1;
+		return;
+	}
+	diff = sample - e->mean;
+	e->mean += ewma_alpha * diff;
+	e->var = (1 - ewma_alpha) * (e->var + ewma_alpha * diff * diff);
+}
+
+/*
+ * Loads are ns per sampled period and the period changes with the
+ * sampling interval, so the averages are kept per second and turned back
+ * into the current period
+ */
+static uint64_t smooth_load(struct ewma *e, uint64_t load)
+{
+	update_ewma(e, (double)load * NSEC_PER_SEC / sample_period_ns);
+	if (ewma_alpha >= 1)
+		return load;
+	return (uint64_t)(e->mean * sample_period_ns / NSEC_PER_SEC);
+}
+
+/*ûƽжϱڵĸأͬʱжƵʵĻƽ*/
+static void smooth_irq_load(struct irq_info *info, void *data __attribute__((unused)))
+{
+	update_ewma(&info->rate, (double)irq_count_delta(info) * NSEC_PER_SEC / sample_period_ns);
+	info->load = smooth_load(&info->load_avg, info->load);
+
+	/*
+	 * Once the cost of an interrupt is learned, predict the load the irq
+	 * brings to any cpu from its rate.  The rate is an average too, so
+	 * with smoothing off (-H 0) the irq's share of this cycle stands.
+	 */
+	if (load_half_life && info->cost_samples >= IRQ_COST_SAMPLES)
+		info->load = (uint64_t)(info->ns_per_irq * info->rate.mean *
+					sample_period_ns / NSEC_PER_SEC);
+	if (!info->load)
+		info->load++;
+}
+
+/*
+ * Learn the cost of one interrupt of each irq from many cycles.  Each
+ * cycle, each cpu gives one equation: its irq time is the sum, over the
+ * irqs that fired on it, of their interrupts times their cost.  A
+ * normalized LMS step per cycle moves the costs towards the least squares
+ * fit of the cycles seen so far.  Two irqs sharing a cpu then still end
+ * up with costs of their own, as long as their rates do not always move
+ * together.  Costs start from the irq's share of the first cycle.  Only
+ * cpus whose irq time was read this cycle give an equation; counting a
+ * cpu without one as zero time would drag the costs of its irqs to 0.
+ */
+
+static void predict_irq_time(struct irq_info *info, void *data __attribute__((unused)))
+{
+	struct irq_cpu_count *cc;
+	struct cpu_irq_stat *st;
+	uint64_t delta = irq_count_delta(info), share = 0;
+	int i;
+
+	/*һΰжϴıֵøCPUжʱ䣬Ϊѧϰ*/
+	if (!info->cost_samples && delta) {
+		for (i = 0; i < info->nr_cpu_counts; i++) {
+			cc = &info->cpu_counts[i];
+			if (cc->delta && cc->cpu < cpu_stats_size && cpu_stats[cc->cpu].timed)
+				share += load_share(cpu_irq_time(&cpu_stats[cc->cpu]), cc->delta,
+						    cpu_stats[cc->cpu].irq_deltas);
+		}
+		info->ns_per_irq = (double)share / delta;
+	}
+	for (i = 0; i < info->nr_cpu_counts; i++) {
+		cc = &info->cpu_counts[i];
+		if (!cc->delta || cc->cpu >= cpu_stats_size || !cpu_stats[cc->cpu].timed)
+			continue;
+		st = &cpu_stats[cc->cpu];
+		st->predicted_ns += info->ns_per_irq * cc->delta;
+		st->delta_sq += (double)cc->delta * cc->delta;
+	}
+}
+
+static void learn_irq_cost(struct irq_info *info, void *data __attribute__((unused)))
+{
+	struct irq_cpu_count *cc;
+	struct cpu_irq_stat *st;
+	double step = 0;
+	int i, fired = 0;
+
+	for (i = 0; i < info->nr_cpu_counts; i++) {
+		cc = &info->cpu_counts[i];
+		if (!cc->delta || cc->cpu >= cpu_stats_size)
+			continue;
+		st = &cpu_stats[cc->cpu];
+		if (!st->timed || !st->delta_sq)
+			continue;
+		step += st->error_ns * cc->delta / st->delta_sq;
+		fired = 1;
+	}
+	if (!fired)
+		return;
+
+	info->ns_per_irq += IRQ_COST_STEP * step;
+	if (info->ns_per_irq < 0)
+		info->ns_per_irq = 0;
+	info->cost_samples++;
+}
+
+/*
+ * Banned irqs are never placed but do take cpu time, so they learn their
+ * costs alongside the others.  Otherwise their time would count as error
+ * and train the costs of the irqs sharing their cpus upwards.
+ */
+static void learn_irq_costs(void)
+{
+	struct cpu_irq_stat *st;
+	int cpu;
+
+	for (cpu = 0; cpu < cpu_stats_size; cpu++) {
+		cpu_stats[cpu].predicted_ns = 0;
+		cpu_stats[cpu].delta_sq = 0;
+	}
+	for_each_irq(NULL, predict_irq_time, NULL);
+	for_each_banned_irq(predict_irq_time, NULL);
+
+	for (cpu = 0; cpu < cpu_stats_size; cpu++) {
+		st = &cpu_stats[cpu];
+		st->error_ns = (double)cpu_irq_time(st) - st->predicted_ns;
+	}
+	for_each_irq(NULL, learn_irq_cost, NULL);
+	for_each_banned_irq(learn_irq_cost, NULL);
+}
+
 /*ؽ0*/
 static void reset_load(struct topo_obj *d, void *data __attribute__((unused)))
 {
@@ -270,52 +1106,78 @@ static void reset_load(struct topo_obj *d, void *data __attribute__((unused)))
 
 void parse_proc_stat(void)
 {
-	FILE *file;
-	char *line = NULL;
-	size_t size = 0;
-	int cpunr, rc, cpucount;
+	char *line, *cursor;
+	int cpunr, rc, cpucount, online;
 	struct topo_obj *cpu;
+	struct cpu_irq_stat *st;
 	unsigned long long irq_load, softirq_load;
+	uint64_t start;
+	int have_softirqs;
 
 /*Ŀ¼ÿһCPUĸؼ¼*/
-	file = fopen("/proc/stat", "r");
-	if (!file) {
+	start = monotonic_ns();
+	if (last_stat_ns && start > last_stat_ns)
+		sample_period_ns = start - last_stat_ns;
+	last_stat_ns = start;
+	ewma_alpha = load_half_life ?
+		1 - exp2(-(double)sample_period_ns / (load_half_life * 1000000.0)) : 1;
+	if (proc_file_read(&proc_stat) < 0) {
 		log(TO_ALL, LOG_WARNING, "WARNING cant open /proc/stat.  balacing is broken\n");
 		return;
 	}
+	cursor = proc_stat.buf;
 
 	/* һCPUͳƺͣҪ*/
-	if (getline(&line, &size, file)==0) {
-		free(line);
+	if (!proc_file_next_line(&cursor, NULL)) {
 		log(TO_ALL, LOG_WARNING, "WARNING read /proc/stat. balancing is broken\n");
-		fclose(file);
 		return;
 	}
 
+	/*ʹøٵʱڵжϴʱɸ߳ͳƣжϵִджϸ*/
+	irq_trace_snapshot();
+	have_softirqs = !irq_trace_active && !parse_proc_softirqs();
+
 	cpucount = 0;
-	while (!feof(file)) {
-		if (getline(&line, &size, file)==0)
-			break;
+	online = 0;
+	for (cpunr = 0; cpunr < cpu_stats_size; cpunr++)
+		cpu_stats[cpunr].timed = 0;
+	while ((line = proc_file_next_line(&cursor, NULL))) {
 
 		/*ֻҪCPUĸϢĺ*/
 		if (!strstr(line, "cpu"))
 			break;
 		/*CPUŰʮƱ*/
 		cpunr = strtoul(&line[3], NULL, 10);
-
-		/*CPUѾbanбУCPU*/
-		if (cpu_isset(cpunr, banned_cpus))
-			continue;
+		online++;
 
 		/*ȡCPUжϺжϸ*/
 		rc = sscanf(line, "%*s %*u %*u %*u %*u %*u %llu %llu", &irq_load, &softirq_load);
 		if (rc < 2)
 			break;	
 
-		/*ȡCPUṹ*/
+		/*
+		 * Keep the irq time of every online cpu, banned ones too: irqs
+		 * pinned to a banned cpu still get their load from it
+		 */
+		if (grow_array((void **)&cpu_stats, &cpu_stats_size,
+			       cpunr + 1, sizeof(struct cpu_irq_stat)))
+			break;
+		st = &cpu_stats[cpunr];
+		if (cycle_count) {
+			split_cpu_load(cpunr, st, irq_load, softirq_load, have_softirqs);
+			st->timed = 1;
+		}
+		st->last_irq_jiffies = irq_load;
+		st->last_softirq_jiffies = softirq_load;
+
+		/*CPUѾbanбУ*/
+		if (cpu_isset(cpunr, banned_cpus))
+			continue;
+
+		/*ȡCPUṹҲʱCPUĿ*/
 		cpu = find_cpu_core(cpunr);
 		if (!cpu)
-			break;
+			continue;
 
 		/*CPU*/
 		cpucount++;
@@ -324,21 +1186,32 @@ void parse_proc_stat(void)
  		 * For each cpu add the irq and softirq load and propagate that
  		 * all the way up the device tree
  		 */
-		if (cycle_count) {
-			cpu->load = (irq_load + softirq_load) - (cpu->last_load);
-			/*
-			 * the [soft]irq_load values are in jiffies, with
-			 * HZ jiffies per second.  Convert the load to nanoseconds
-			 * to get a better integer resolution of nanoseconds per
-			 * interrupt.
-			 */
-			cpu->load *= NSEC_PER_SEC/HZ;
-		}
+		if (cycle_count)
+			cpu->load = smooth_load(&cpu->load_avg, cpu_irq_time(st));
 		cpu->last_load = (irq_load + softirq_load);
 	}
 
-	fclose(file);
-	free(line);
+	log(TO_CONSOLE, LOG_INFO, "Read %lu bytes from %s, parsed in %lu us\n",
+	    (unsigned long)proc_stat.len, proc_stat.path,
+	    (unsigned long)((monotonic_ns() - start) / 1000));
+
+	/*
+	 * per_cpu_count has a count for every possible cpu, so in that mode
+	 * hotplug only shows as a change in the number of online cpus.  A
+	 * mismatch asks for one rescan; if the rebuilt topology still
+	 * disagrees, nothing more can be done about it until the number of
+	 * online cpus changes again.
+	 */
+	if (sysfs_irq_dir) {
+		if (online == get_online_cpu_count())
+			rescanned_online = -1;
+		else if (online != rescanned_online) {
+			rescanned_online = online;
+			need_rescan = 1;
+			return;
+		}
+	}
+
 	if (cpucount != get_cpu_count()) {
 		log(TO_ALL, LOG_WARNING, "WARNING, didn't collect load info for all cpus, balancing is broken\n");
 		return;
@@ -351,9 +1224,26 @@ void parse_proc_stat(void)
  	 * Now that we have load for each cpu attribute a fair share of the load
  	 * to each irq on that cpu
  	 */
+	if (!nr_columns)
+		for_each_object(numa_nodes, compute_irq_count_share, NULL);
 	for_each_object(cpus, compute_irq_branch_load_share, NULL);
 	for_each_object(cache_domains, compute_irq_branch_load_share, NULL);
 	for_each_object(packages, compute_irq_branch_load_share, NULL);
 	for_each_object(numa_nodes, compute_irq_branch_load_share, NULL);
 
+	if (nr_columns)
+		for_each_irq(NULL, attribute_irq_load, NULL);
+
+	/*
+	 * The cost of an interrupt is learned from where each irq fired, so
+	 * per cpu counts are needed.  With tracing the handler time of each
+	 * irq is measured, there is nothing to learn.
+	 */
+	if (nr_columns && cycle_count && !irq_trace_active)
+		learn_irq_costs();
+
+	/*ؾⰴƽĸؽУһ¾*/
+	if (cycle_count)
+		for_each_irq(NULL, smooth_irq_load, NULL);
+
 }
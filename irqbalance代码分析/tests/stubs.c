@@ -0,0 +1,48 @@
+/*
+ * Globals and event loop hooks of irqbalance.c, for the test programs.
+ * They link every module but the one under test, which they include to
+ * reach its static functions, and irqbalance.c, which has main().
+ */
+#include "config.h"
+#include <stdint.h>
+#include <limits.h>
+
+#include "irqbalance.h"
+
+volatile int keep_going = 1;
+int one_shot_mode;
+int debug_mode;
+int foreground_mode;
+int tracefs_mode;
+int numa_avail;
+int need_rescan;
+unsigned int log_mask = 0;
+enum hp_e global_hint_policy = HINT_POLICY_IGNORE;
+unsigned long power_thresh = ULONG_MAX;
+unsigned long solver_budget = 0;
+unsigned long load_half_life = LOAD_HALF_LIFE;
+unsigned long deepest_cache = 2;
+unsigned long long cycle_count = 0;
+char *pidfile = NULL;
+char *banscript = NULL;
+char *polscript = NULL;
+long HZ = 100;
+unsigned long min_interval = MIN_SAMPLE_INTERVAL;
+unsigned long max_interval = MAX_SAMPLE_INTERVAL;
+unsigned long sample_interval = SLEEP_INTERVAL * 1000;
+
+int add_event_source(int fd __attribute__((unused)),
+		     uint32_t events __attribute__((unused)),
+		     event_handler_t handler __attribute__((unused)),
+		     void *data __attribute__((unused)))
+{
+	return -1;
+}
+
+void remove_event_source(int fd __attribute__((unused)))
+{
+}
+
+void request_cycle(void)
+{
+}
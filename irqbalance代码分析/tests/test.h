@@ -0,0 +1,19 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+/* minimal checks for the test programs, which exit non-zero on a failure */
+static int test_failures;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__FILE__, __LINE__, #cond);			\
+		test_failures++;					\
+	}								\
+} while (0)
+
+#define TEST_RESULT() (test_failures ? 1 : 0)
+
+#endif
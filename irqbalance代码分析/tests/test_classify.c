@@ -0,0 +1,141 @@
+/*
+ * sort_irq_list(): class and load descending, then irq number, and stable
+ * for irqs whose keys are all equal
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "irqbalance.h"
+#include "tests/test.h"
+
+#define MAX_IRQS 600
+
+static struct irq_info irqs[MAX_IRQS];
+static unsigned int input_pos[MAX_IRQS];
+
+static int cmp_ref(const void *a, const void *b)
+{
+	const struct irq_info *x = *(struct irq_info * const *)a;
+	const struct irq_info *y = *(struct irq_info * const *)b;
+
+	if (x->class != y->class)
+		return x->class > y->class ? -1 : 1;
+	if (x->load != y->load)
+		return x->load > y->load ? -1 : 1;
+	if (x->irq != y->irq)
+		return x->irq < y->irq ? -1 : 1;
+	/* equal keys keep their input order */
+	return input_pos[x - irqs] < input_pos[y - irqs] ? -1 : 1;
+}
+
+/* the list order must be the order of ref, with consistent links */
+static void check_list(struct irq_list *list, struct irq_info **ref, unsigned int n)
+{
+	struct irq_link *link, *prev = NULL;
+	unsigned int i = 0;
+
+	CHECK(list->count == n);
+	for (link = list->first; link; prev = link, link = link->next, i++) {
+		if (i >= n || link->info != ref[i]) {
+			CHECK(0);
+			return;
+		}
+		CHECK(link->prev == prev);
+		CHECK(link->list == list);
+	}
+	CHECK(i == n);
+	CHECK(list->last == prev);
+}
+
+static uint64_t random_load(int spread)
+{
+	switch (spread) {
+	case 0:
+		return random() % 4;
+	case 1:
+		return random() % 100000;
+	default:
+		return ((uint64_t)random() << 33) ^ ((uint64_t)random() << 2) ^ (random() & 3);
+	}
+}
+
+static void test_random(void)
+{
+	static struct irq_info *ref[MAX_IRQS], *order[MAX_IRQS];
+	struct irq_list list;
+	unsigned int n, i, j;
+	int round;
+
+	for (round = 0; round < 300; round++) {
+		n = random() % MAX_IRQS;
+		memset(irqs, 0, sizeof(irqs));
+		for (i = 0; i < n; i++) {
+			irqs[i].irq = round % 3 ? (int)(random() % 4096) : (int)i;
+			irqs[i].class = random() % IRQ_CLASSES;
+			irqs[i].load = random_load(round % 3);
+			order[i] = &irqs[i];
+		}
+		/* insert in shuffled order, ties between equal keys in that order */
+		for (i = n; i > 1; i--) {
+			struct irq_info *t;
+
+			j = random() % i;
+			t = order[i - 1];
+			order[i - 1] = order[j];
+			order[j] = t;
+		}
+		irq_list_init(&list, 0);
+		for (i = 0; i < n; i++) {
+			irq_list_append(&list, order[i]);
+			input_pos[order[i] - irqs] = i;
+			ref[i] = order[i];
+		}
+		qsort(ref, n, sizeof(ref[0]), cmp_ref);
+
+		sort_irq_list(&list);
+		check_list(&list, ref, n);
+
+		/* sorting a sorted list changes nothing */
+		sort_irq_list(&list);
+		check_list(&list, ref, n);
+	}
+}
+
+static void test_small(void)
+{
+	struct irq_info *ref[3];
+	struct irq_list list;
+
+	memset(irqs, 0, sizeof(irqs));
+	irq_list_init(&list, 0);
+	sort_irq_list(&list);
+	CHECK(list.first == NULL && list.last == NULL && list.count == 0);
+
+	irqs[0].irq = 5;
+	irq_list_append(&list, &irqs[0]);
+	sort_irq_list(&list);
+	ref[0] = &irqs[0];
+	check_list(&list, ref, 1);
+
+	/* class before load before irq number */
+	irqs[1].irq = 9;
+	irqs[1].class = 1;
+	irqs[2].irq = 1;
+	irqs[2].load = 7;
+	irq_list_append(&list, &irqs[1]);
+	irq_list_append(&list, &irqs[2]);
+	sort_irq_list(&list);
+	ref[0] = &irqs[1];
+	ref[1] = &irqs[2];
+	ref[2] = &irqs[0];
+	check_list(&list, ref, 3);
+}
+
+int main(void)
+{
+	srandom(1);
+	test_small();
+	test_random();
+	return TEST_RESULT();
+}
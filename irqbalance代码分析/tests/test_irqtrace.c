@@ -0,0 +1,112 @@
+/*
+ * handle_trace_line(): pairing of the irq and softirq tracepoints from
+ * trace_pipe into per-irq and per-cpu handler time
+ */
+#include "irqtrace.c"
+
+#include "tests/test.h"
+
+static void feed(const char *line)
+{
+	char buf[256];
+
+	snprintf(buf, sizeof(buf), "%s", line);
+	handle_trace_line(buf);
+}
+
+static uint64_t irq_ns(int irq)
+{
+	return irq < live.irq_size ? live.irq_ns[irq] : 0;
+}
+
+static uint64_t hardirq_ns(int cpu)
+{
+	return cpu < live.cpu_size ? live.hardirq_ns[cpu] : 0;
+}
+
+static uint64_t softirq_ns(int cpu, int vec)
+{
+	return cpu < live.cpu_size ? live.softirq_ns[cpu * NR_SOFTIRQ_VECS + vec] : 0;
+}
+
+static void test_handler(void)
+{
+	feed("          <idle>-0       [002] d.h1.  4136.000100: irq_handler_entry: irq=30 name=eth0");
+	feed("          <idle>-0       [002] d.h1.  4136.000150: irq_handler_exit: irq=30 ret=handled");
+	CHECK(irq_ns(30) == 50000);
+	CHECK(hardirq_ns(2) == 50000);
+
+	/* fewer than 9 fractional digits, and a task name with blanks */
+	feed("   kworker/u16:2 x-123   [002] d.h..    12.5: irq_handler_entry: irq=30 name=eth0");
+	feed("   kworker/u16:2 x-123   [002] d.h..    12.500001: irq_handler_exit: irq=30 ret=handled");
+	CHECK(irq_ns(30) == 51000);
+	CHECK(hardirq_ns(2) == 51000);
+}
+
+static void test_unpaired(void)
+{
+	/* exit of another irq than the one that entered */
+	feed("          <idle>-0       [003] d.h1.   100.000000: irq_handler_entry: irq=40 name=a");
+	feed("          <idle>-0       [003] d.h1.   100.000010: irq_handler_exit: irq=41 ret=handled");
+	/* exit without entry, the entry state was reset above */
+	feed("          <idle>-0       [003] d.h1.   100.000020: irq_handler_exit: irq=40 ret=handled");
+	/* time going backwards */
+	feed("          <idle>-0       [003] d.h1.   100.000030: irq_handler_entry: irq=42 name=b");
+	feed("          <idle>-0       [003] d.h1.   100.000020: irq_handler_exit: irq=42 ret=handled");
+	/* softirq exit without entry, and a vector out of range */
+	feed("          <idle>-0       [003] ..s1.   100.000040: softirq_exit: vec=3 [action=NET_RX]");
+	feed("          <idle>-0       [003] ..s1.   100.000050: softirq_entry: vec=99 [action=X]");
+	feed("          <idle>-0       [003] ..s1.   100.000060: softirq_exit: vec=99 [action=X]");
+	/* not a trace line at all */
+	feed("# tracer: nop");
+	feed("");
+
+	CHECK(irq_ns(40) == 0 && irq_ns(41) == 0 && irq_ns(42) == 0);
+	CHECK(hardirq_ns(3) == 0);
+	CHECK(softirq_ns(3, 3) == 0);
+}
+
+/* hardirq time inside a softirq is counted once, on the hardirq */
+static void test_nested_softirq(void)
+{
+	feed("          <idle>-0       [004] ..s1.   200.000000: softirq_entry: vec=3 [action=NET_RX]");
+	feed("          <idle>-0       [004] d.H1.   200.000010: irq_handler_entry: irq=50 name=eth1");
+	feed("          <idle>-0       [004] d.H1.   200.000030: irq_handler_exit: irq=50 ret=handled");
+	feed("          <idle>-0       [004] d.H1.   200.000040: irq_handler_entry: irq=51 name=eth2");
+	feed("          <idle>-0       [004] d.H1.   200.000045: irq_handler_exit: irq=51 ret=handled");
+	feed("          <idle>-0       [004] ..s1.   200.000100: softirq_exit: vec=3 [action=NET_RX]");
+	CHECK(irq_ns(50) == 20000 && irq_ns(51) == 5000);
+	CHECK(hardirq_ns(4) == 25000);
+	CHECK(softirq_ns(4, 3) == 75000);
+
+	/* the nested time doesn't carry over into the next softirq */
+	feed("          <idle>-0       [004] ..s1.   201.000000: softirq_entry: vec=3 [action=NET_RX]");
+	feed("          <idle>-0       [004] ..s1.   201.000010: softirq_exit: vec=3 [action=NET_RX]");
+	CHECK(softirq_ns(4, 3) == 85000);
+}
+
+/* lost events make every open handler on every cpu unpairable */
+static void test_lost(void)
+{
+	feed("          <idle>-0       [005] d.h1.   300.000000: irq_handler_entry: irq=60 name=c");
+	feed("          <idle>-0       [006] ..s1.   300.000000: softirq_entry: vec=1 [action=TIMER]");
+	feed("CPU:5 [LOST 12 EVENTS]");
+	feed("          <idle>-0       [005] d.h1.   300.000010: irq_handler_exit: irq=60 ret=handled");
+	feed("          <idle>-0       [006] ..s1.   300.000010: softirq_exit: vec=1 [action=TIMER]");
+	CHECK(irq_ns(60) == 0 && hardirq_ns(5) == 0);
+	CHECK(softirq_ns(6, 1) == 0);
+
+	/* and pairing works again afterwards */
+	feed("          <idle>-0       [005] d.h1.   301.000000: irq_handler_entry: irq=60 name=c");
+	feed("          <idle>-0       [005] d.h1.   301.000003: irq_handler_exit: irq=60 ret=handled");
+	CHECK(irq_ns(60) == 3000 && hardirq_ns(5) == 3000);
+}
+
+int main(void)
+{
+	test_handler();
+	test_unpaired();
+	test_nested_softirq();
+	test_lost();
+	return TEST_RESULT();
+}
@@ -0,0 +1,121 @@
+/*
+ * pick_best_object(): the heap walk must pick the same child as the
+ * linear find_best_object() scan it replaced, for any cost function
+ * that keeps to the rule of never going below the load, and as loads
+ * change between irqs
+ */
+#include "placement.c"
+
+#include <stdlib.h>
+#include "tests/test.h"
+
+#define MAX_OBJS 70
+
+static struct topo_obj objs[MAX_OBJS];
+static uint64_t penalty[MAX_OBJS];
+
+static uint64_t test_cost(struct topo_obj *d, struct irq_info *info __attribute__((unused)))
+{
+	return d->load + penalty[d->number];
+}
+
+static struct topo_obj *linear_best(GList *list, struct irq_info *info)
+{
+	struct obj_placement place;
+
+	place.info = info;
+	place.best = NULL;
+	place.best_cost = 0;
+	for_each_object(list, find_best_object, &place);
+	return place.best;
+}
+
+/* few distinct values, so that cost, load and irq count ties are common */
+static uint64_t random_value(int spread)
+{
+	return spread ? (uint64_t)random() % 1000000 : (uint64_t)random() % 4;
+}
+
+static void test_random(void)
+{
+	struct irq_info info;
+	struct topo_obj *heap_pick, *linear_pick;
+	GList *list;
+	int round, n, i, irq, spread;
+
+	memset(&info, 0, sizeof(info));
+	placement_cost = test_cost;
+	for (round = 0; round < 2000; round++) {
+		n = 1 + random() % MAX_OBJS;
+		spread = round & 1;
+		list = NULL;
+		memset(objs, 0, sizeof(objs));
+		for (i = 0; i < n; i++) {
+			objs[i].obj_type = OBJ_TYPE_CPU;
+			objs[i].number = i;
+			objs[i].load = random_value(spread);
+			objs[i].powersave_mode = random() % 8 == 0;
+			irq_list_init(&objs[i].interrupts, 0);
+			objs[i].interrupts.count = random() % 3;
+			penalty[i] = random() % 4 ? 0 : random_value(spread);
+			list = g_list_append(list, &objs[i]);
+		}
+
+		/* place a run of irqs, each loading the child it went to */
+		heap_build(&place_heap, list);
+		for (irq = 0; irq < 3 * n; irq++) {
+			heap_pick = pick_best_object(list, &info);
+			linear_pick = linear_best(list, &info);
+			CHECK(heap_pick == linear_pick);
+			if (!heap_pick)
+				break;
+			heap_pick->load += random_value(spread);
+			heap_pick->interrupts.count++;
+			heap_update(&place_heap, heap_pick);
+		}
+		g_list_free(list);
+	}
+	placement_cost = penalty_cost;
+}
+
+/* ties on load go to the child with fewest irqs, then the first one */
+static void test_ties(void)
+{
+	struct irq_info info;
+	GList *list = NULL;
+	int i;
+
+	memset(&info, 0, sizeof(info));
+	memset(objs, 0, sizeof(objs));
+	memset(penalty, 0, sizeof(penalty));
+	placement_cost = test_cost;
+	for (i = 0; i < 4; i++) {
+		objs[i].obj_type = OBJ_TYPE_CPU;
+		objs[i].number = i;
+		objs[i].load = 10;
+		irq_list_init(&objs[i].interrupts, 0);
+		objs[i].interrupts.count = i == 0 ? 3 : 1;
+		list = g_list_append(list, &objs[i]);
+	}
+	heap_build(&place_heap, list);
+	CHECK(pick_best_object(list, &info) == &objs[1]);
+
+	/* a penalty sends the irq on to the next best child */
+	penalty[1] = 1;
+	CHECK(pick_best_object(list, &info) == &objs[2]);
+
+	/* a less loaded child goes first even with more irqs */
+	objs[0].load = 9;
+	heap_update(&place_heap, &objs[0]);
+	CHECK(pick_best_object(list, &info) == &objs[0]);
+	placement_cost = penalty_cost;
+	g_list_free(list);
+}
+
+int main(void)
+{
+	srandom(1);
+	test_ties();
+	test_random();
+	return TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+/*
+ * parse_count(): the SWAR count parser shared by the /proc/interrupts,
+ * /proc/softirqs and per_cpu_count backends
+ */
+#include "procinterrupts.c"
+
+#include <inttypes.h>
+#include "tests/test.h"
+
+/* parse all counts of s, which need not be NUL terminated at len */
+static int parse_all(const char *s, size_t len, uint64_t *vals, int max, size_t *used)
+{
+	static char buf[256];
+	char *pos = buf;
+	int n = 0;
+
+	memcpy(buf, s, len);
+	/* make sure nothing past len looks like a digit */
+	memset(buf + len, '9', sizeof(buf) - len);
+	while (n < max && parse_count(&pos, buf + len, &vals[n])) {
+		n++;
+		if (pos < buf + len && *pos == ',')
+			pos++;
+	}
+	*used = pos - buf;
+	return n;
+}
+
+static void test_fixed(void)
+{
+	uint64_t v[8];
+	size_t used;
+
+	CHECK(parse_all("123 456", 7, v, 8, &used) == 2);
+	CHECK(v[0] == 123 && v[1] == 456 && used == 7);
+
+	/* stops at the first field that isn't a count, without moving */
+	CHECK(parse_all("   42    7  IO-APIC-edge  timer", 31, v, 8, &used) == 2);
+	CHECK(v[0] == 42 && v[1] == 7 && used == 10);
+
+	/* exactly one and two SWAR chunks, and a chunk cut short by end */
+	CHECK(parse_all("12345678", 8, v, 8, &used) == 1 && v[0] == 12345678ULL);
+	CHECK(parse_all("1234567890123456", 16, v, 8, &used) == 1 &&
+	      v[0] == 1234567890123456ULL);
+	CHECK(parse_all("123456789", 9, v, 8, &used) == 1 && v[0] == 123456789ULL);
+	CHECK(parse_all("18446744073709551615", 20, v, 8, &used) == 1 &&
+	      v[0] == UINT64_MAX);
+
+	/* per_cpu_count is comma separated, with a newline at the end */
+	CHECK(parse_all("0,22,333333333,4\n", 17, v, 8, &used) == 4);
+	CHECK(v[0] == 0 && v[1] == 22 && v[2] == 333333333ULL && v[3] == 4);
+
+	CHECK(parse_all("", 0, v, 8, &used) == 0 && used == 0);
+	CHECK(parse_all("    ", 4, v, 8, &used) == 0);
+	CHECK(parse_all("x1", 2, v, 8, &used) == 0 && used == 0);
+}
+
+/* random counts, padded and separated like /proc/interrupts, against strtoull */
+static void test_random(void)
+{
+	char line[256], *p;
+	uint64_t want[8], got[8];
+	size_t used;
+	int round, i, n, digits;
+
+	srandom(1);
+	for (round = 0; round < 20000; round++) {
+		p = line;
+		n = 1 + random() % 8;
+		for (i = 0; i < n; i++) {
+			digits = 1 + random() % 20;
+			want[i] = random() % 9 + 1;
+			while (--digits && want[i] <= (UINT64_MAX - 9) / 10)
+				want[i] = want[i] * 10 + random() % 10;
+			p += sprintf(p, "%*s%" PRIu64, (int)(!!i + random() % 4), "", want[i]);
+		}
+		p += sprintf(p, "  PCI-MSI-edge  eth0");
+		CHECK(parse_all(line, p - line, got, 8, &used) == n);
+		for (i = 0; i < n; i++)
+			CHECK(got[i] == want[i]);
+		if (test_failures)
+			break;
+	}
+}
+
+int main(void)
+{
+	test_fixed();
+	test_random();
+	return TEST_RESULT();
+}
@@ -21,6 +21,7 @@
 #define IRQ_GBETH       5
 #define IRQ_10GBETH     6
 #define IRQ_VIRT_EVENT  7
+#define IRQ_CLASSES     8
 
 /*
  * IRQ Types
@@ -30,6 +31,23 @@
 #define IRQ_TYPE_MSIX       2
 #define IRQ_TYPE_VIRT_EVENT 3
 
+/*
+ * Softirq vectors are numbered in the order of the /proc/softirqs rows,
+ * which is also the vec= of the softirq tracepoints
+ */
+#define NR_SOFTIRQ_VECS	16
+
+/*
+ * Which irqs the softirq time of a cpu is charged to
+ */
+enum softirq_group_e {
+	SOFTIRQ_GROUP_DEVICE,	/* HI, TASKLET: any irq */
+	SOFTIRQ_GROUP_NET,	/* NET_RX, NET_TX: network irqs */
+	SOFTIRQ_GROUP_BLOCK,	/* BLOCK, IRQ_POLL: storage irqs */
+	SOFTIRQ_GROUP_NONE,	/* TIMER, HRTIMER, SCHED, RCU: no irq */
+	SOFTIRQ_GROUPS
+};
+
 /*
  * IRQ Internal tracking flags
  */
@@ -42,17 +60,105 @@ enum obj_type_e {
 	OBJ_TYPE_NODE
 };
 
+struct irq_info;
+struct irq_list;
+
+/*
+ * Link embedded in irq_info.  It knows its irq and the list it is on, so
+ * an irq can be unlinked or moved without searching for it
+ */
+struct irq_link {
+	struct irq_link *next;
+	struct irq_link *prev;
+	struct irq_list *list;
+	struct irq_info *info;
+};
+
+/*
+ * Exponentially weighted moving average of a per cycle sample and of the
+ * variance around it, see update_ewma()
+ */
+struct ewma {
+	double mean;
+	double var;
+	int primed;
+};
+
+/*
+ * List of irqs with O(1) append, removal and length.  Database lists
+ * (interrupts_db, the banned irqs) link through irq_info.db_link,
+ * placement lists (an object's irqs, rebalance_irq_list) through
+ * irq_info.link, so an irq is on at most one list of each kind
+ */
+struct irq_list {
+	struct irq_link *first;
+	struct irq_link *last;
+	unsigned int count;
+	int db;
+	uint64_t delta;		/* irq count delta of this cycle, summed over the list */
+};
+
 struct topo_obj {
 	uint64_t load;
 	uint64_t last_load;
+	uint64_t irq_share;	/* irqs of this cycle attributed to the object */
+	int heap_pos;		/* slot in the placement heap, see placement.c */
+	struct ewma load_avg;	/* irq and softirq time of a cpu, ns per second */
+	unsigned int class_count[IRQ_CLASSES];	/* irqs of each class placed in the subtree */
 	enum obj_type_e obj_type;
 	int number;
 	int powersave_mode;
-	cpumask_t mask;
-	GList *interrupts;
+	struct irq_list interrupts;
 	struct topo_obj *parent;
 	GList *children;
 	GList **obj_type_list;
+	/*
+	 * The mask is kept last so that everything above, all that most
+	 * walks over the tree read, sits together at the front
+	 */
+	cpumask_t mask;
+};
+
+/*
+ * Objects of one kind are carved out of fixed size chunks so that walking
+ * them stays within neighbouring memory.  Chunks never move, freed objects
+ * are reused, and a rescan resets the whole pool at once while keeping its
+ * chunks for the next build.
+ */
+#define OBJ_POOL_CHUNK 64
+
+struct obj_pool_chunk {
+	struct obj_pool_chunk *next;
+	int used;
+	char objs[] __attribute__((aligned(64)));
+};
+
+struct obj_pool {
+	size_t obj_size;
+	struct obj_pool_chunk *chunks;
+	struct obj_pool_chunk *cur;	/* chunk objects are carved from, later ones are empty */
+	void *free_objs;
+};
+
+#define OBJ_POOL_INIT(type) { .obj_size = sizeof(type) }
+
+/*
+ * Dense array of topo_objs indexed by their number, for O(1) lookups
+ */
+struct topo_index {
+	struct topo_obj **objs;
+	int size;
+	int count;
+};
+
+/*
+ * Interrupt count of an irq on a single cpu.  Only cpus on which the irq
+ * has fired at least once get an entry, kept sorted by cpu number
+ */
+struct irq_cpu_count {
+	int cpu;
+	uint64_t count;
+	uint64_t delta;
 };
 
 struct irq_info {
@@ -62,7 +168,6 @@ struct irq_info {
 	int level;
 	int flags;
 	struct topo_obj *numa_node;
-	cpumask_t cpumask;
 	cpumask_t affinity_hint;
 	int hint_policy;
 	uint64_t irq_count;
@@ -70,6 +175,20 @@ struct irq_info {
 	uint64_t load;
 	int moved;
 struct topo_obj *assigned_obj;
+	struct irq_cpu_count *cpu_counts;
+	int nr_cpu_counts;
+	int cpu_counts_size;
+	uint64_t seen_generation;
+	int home_package;	/* package the irq was last placed in, -1 if none */
+	uint64_t moved_ns;	/* when the affinity was last written, 0 if never */
+	unsigned int nr_moves;	/* affinity writes since the irq was found */
+	struct ewma rate;	/* interrupts per second */
+	struct ewma load_avg;	/* attributed load, ns per second */
+	double ns_per_irq;	/* learned cost of one interrupt, see learn_irq_costs() */
+	unsigned int cost_samples;	/* cycles ns_per_irq has learned from */
+	struct irq_info *dev_next;	/* ring of the msi vectors of one device, NULL if alone */
+	struct irq_link link;
+	struct irq_link db_link;
 };
 
 #endif
@@ -0,0 +1,167 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <linux/netlink.h>
+
+#include "irqbalance.h"
+
+#define UEVENT_BUF_LEN 8192
+#define UEVENT_RCVBUF (1024 * 1024)
+#define PCI_DEVPATH_PREFIX "/devices/pci"
+#define CPU_DEVPATH_PREFIX "/devices/system/cpu/cpu"
+
+/*
+ * Kernel uevents for cpu hotplug and pci devices coming and going, so
+ * that new cpus and new device irqs are picked up right away instead of
+ * at the next sample that happens to notice them
+ */
+static int uevent_fd = -1;
+
+struct uevent {
+	const char *action;
+	const char *devpath;
+	const char *subsystem;
+};
+
+/*һueventϢȡACTIONDEVPATHSUBSYSTEM*/
+static void parse_uevent(char *buf, ssize_t len, struct uevent *ev)
+{
+	char *p = buf, *end = buf + len;
+
+	memset(ev, 0, sizeof(*ev));
+	/* the first string is the "action@devpath" summary, the rest KEY=value */
+	while (p < end) {
+		if (!strncmp(p, "ACTION=", 7))
+			ev->action = p + 7;
+		else if (!strncmp(p, "DEVPATH=", 8))
+			ev->devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			ev->subsystem = p + 10;
+		p += strlen(p) + 1;
+	}
+}
+
+/*CPU߻ߣҪ˽ṹ*/
+static void handle_cpu_uevent(struct uevent *ev)
+{
+	const char *num;
+
+	if (strncmp(ev->devpath, CPU_DEVPATH_PREFIX, strlen(CPU_DEVPATH_PREFIX)))
+		return;
+	/*ֻcpuNcpuN/cache/indexM豸¼Ӱ˽ṹ*/
+	num = ev->devpath + strlen(CPU_DEVPATH_PREFIX);
+	if (!*num || num[strspn(num, "0123456789")])
+		return;
+	if (strcmp(ev->action, "online") && strcmp(ev->action, "offline") &&
+	    strcmp(ev->action, "add") && strcmp(ev->action, "remove"))
+		return;
+
+	log(TO_CONSOLE, LOG_INFO, "cpu %s %s, updating the cpu topology\n", num, ev->action);
+	need_rescan = 1;
+}
+
+/*PCI豸ʱֻɨһ豸жϣ豸ƳʱԱɾж*/
+static void handle_pci_uevent(struct uevent *ev)
+{
+	const char *dev = strrchr(ev->devpath, '/') + 1;
+	int added;
+
+	if (strncmp(ev->devpath, PCI_DEVPATH_PREFIX, strlen(PCI_DEVPATH_PREFIX)))
+		return;
+
+	if (!strcmp(ev->action, "add") || !strcmp(ev->action, "bind") ||
+	    !strcmp(ev->action, "change")) {
+		added = add_pci_device_irqs(dev);
+		log(TO_CONSOLE, LOG_INFO, "pci device %s %s, %d new irqs\n", dev, ev->action, added);
+		if (added)
+			request_cycle();
+	} else if (!strcmp(ev->action, "remove") || !strcmp(ev->action, "unbind")) {
+		log(TO_CONSOLE, LOG_INFO, "pci device %s %s\n", dev, ev->action);
+		request_cycle();
+	}
+}
+
+/*ȡŶӵueventϢ*/
+static void uevent_ready(int fd, uint32_t events __attribute__((unused)),
+			 void *data __attribute__((unused)))
+{
+	char buf[UEVENT_BUF_LEN];
+	struct sockaddr_nl addr;
+	socklen_t addrlen;
+	struct uevent ev;
+	ssize_t len;
+
+	for (;;) {
+		addrlen = sizeof(addr);
+		len = recvfrom(fd, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&addr, &addrlen);
+		if (len < 0) {
+			/*ջʧ¼ֻܿ½˽ṹֲ*/
+			if (errno == ENOBUFS) {
+				log(TO_ALL, LOG_WARNING, "uevents were lost, rescanning\n");
+				need_rescan = 1;
+				continue;
+			}
+			break;
+		}
+		/*ֻں˷Ϣ*/
+		if (addr.nl_pid != 0)
+			continue;
+		buf[len] = '\0';
+
+		parse_uevent(buf, len, &ev);
+		if (!ev.action || !ev.devpath || !ev.subsystem || !strrchr(ev.devpath, '/'))
+			continue;
+		if (!strcmp(ev.subsystem, "cpu"))
+			handle_cpu_uevent(&ev);
+		else if (!strcmp(ev.subsystem, "pci"))
+			handle_pci_uevent(&ev);
+	}
+}
+
+/*
+ * Subscribe to kernel uevents and hand the socket to the main loop.
+ * Without them hotplug is still noticed, just later, by the sampling.
+ */
+void init_uevent_listener(void)
+{
+	struct sockaddr_nl addr;
+	int rcvbuf = UEVENT_RCVBUF;
+
+	uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			   NETLINK_KOBJECT_UEVENT);
+	if (uevent_fd < 0)
+		goto out_fail;
+
+	/* hotplugging many cpus at once sends a burst of events */
+	setsockopt(uevent_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;
+	if (bind(uevent_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    add_event_source(uevent_fd, EPOLLIN, uevent_ready, NULL))
+		goto out_close;
+	return;
+
+out_close:
+	close(uevent_fd);
+	uevent_fd = -1;
+out_fail:
+	log(TO_ALL, LOG_WARNING, "Unable to listen for uevents, hotplug will be noticed late\n");
+}
+
+/*ֹͣuevent*/
+void stop_uevent_listener(void)
+{
+	if (uevent_fd < 0)
+		return;
+	remove_event_source(uevent_fd);
+	close(uevent_fd);
+	uevent_fd = -1;
+}